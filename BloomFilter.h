@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BLOOM_FILTER_AVX2 1
+#endif
+
+#include "HashFunctions.h"
+#include "NaiveHashSet.h"
+#include "UnorderedMap.h"
+
+namespace BloomFilterConstants {
+constexpr size_t WORDS_PER_BLOCK = 8;
+constexpr size_t BLOCK_BITS = WORDS_PER_BLOCK * 32;
+// ~0.5% false positives for the split block layout
+constexpr double DEFAULT_BITS_PER_ELEMENT = 12.0;
+constexpr size_t MIN_CAPACITY = 64;
+
+// odd multipliers, one per word, picking that word's bit from the low 32 bits of the hash
+// (the ones from the Parquet split block Bloom filter spec)
+constexpr uint32_t SALTS[WORDS_PER_BLOCK] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+};
+
+// Split block Bloom filter: the high 32 bits of the hash pick one 256 bit block (8 x 32 bit words),
+// and the low 32 bits set exactly one bit in each of its words.
+// So every insert and every query touches a single block within one cache line,
+// and all 8 probes are computed at once (one AVX2 multiply, shift and test when available).
+// Takes already well mixed 64 bit hashes; no false negatives, no removal.
+class BlockedBloomFilter {
+    struct alignas(32) Block {
+        uint32_t words[BloomFilterConstants::WORDS_PER_BLOCK];
+    };
+
+public:
+    explicit BlockedBloomFilter(size_t expectedElements = BloomFilterConstants::MIN_CAPACITY,
+        double bitsPerElement = BloomFilterConstants::DEFAULT_BITS_PER_ELEMENT)
+        : expected(std::max(expectedElements, BloomFilterConstants::MIN_CAPACITY))
+        , bitsPerElement(bitsPerElement)
+    {
+        if (bitsPerElement <= 0.0)
+            throw std::logic_error("Cannot initialize a Bloom filter with non-positive bits per element");
+
+        size_t blockCount = static_cast<size_t>(expected * bitsPerElement / BloomFilterConstants::BLOCK_BITS) + 1;
+        blocks.assign(blockCount, Block {});
+    }
+
+    // O(const): one block
+    void insert(uint64_t hash)
+    {
+        Block& block = blocks[blockIndex(hash)];
+        uint32_t low = static_cast<uint32_t>(hash);
+
+#ifdef BLOOM_FILTER_AVX2
+        __m256i* words = reinterpret_cast<__m256i*>(block.words);
+        _mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words), probeMask(low)));
+#else
+        for (size_t i = 0; i < BloomFilterConstants::WORDS_PER_BLOCK; ++i)
+            block.words[i] |= probeBit(low, i);
+#endif
+
+        ++inserted;
+    }
+
+    // O(const): false means the hash was never inserted, true means it probably was
+    bool mayContain(uint64_t hash) const
+    {
+        const Block& block = blocks[blockIndex(hash)];
+        uint32_t low = static_cast<uint32_t>(hash);
+
+#ifdef BLOOM_FILTER_AVX2
+        // testc: every bit of the mask is set in the block
+        return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(block.words)), probeMask(low));
+#else
+        for (size_t i = 0; i < BloomFilterConstants::WORDS_PER_BLOCK; ++i)
+            if (!(block.words[i] & probeBit(low, i)))
+                return false;
+
+        return true;
+#endif
+    }
+
+    void clear()
+    {
+        blocks.assign(blocks.size(), Block {});
+        inserted = 0;
+    }
+
+    // how many elements the filter was sized for
+    size_t capacity() const { return expected; }
+
+    // inserts so far (repeated ones included)
+    size_t size() const { return inserted; }
+
+    double bits_per_element() const { return bitsPerElement; }
+
+    // O(m): the chance that a hash that was never inserted passes, from the bits that are actually set -
+    // a query hits a random block and passes if the bit it picks in each word is set
+    double false_positive_rate() const
+    {
+        double total = 0.0;
+
+        for (const Block& block : blocks) {
+            double passing = 1.0;
+            for (uint32_t word : block.words)
+                passing *= popcount(word) / 32.0;
+
+            total += passing;
+        }
+
+        return total / blocks.size();
+    }
+
+private:
+    // multiply-shift onto [0, blocks) - no division, and it uses the high bits of the hash
+    size_t blockIndex(uint64_t hash) const
+    {
+        return static_cast<size_t>(((hash >> 32) * blocks.size()) >> 32);
+    }
+
+    static uint32_t probeBit(uint32_t low, size_t word)
+    {
+        return uint32_t(1) << ((low * BloomFilterConstants::SALTS[word]) >> 27);
+    }
+
+#ifdef BLOOM_FILTER_AVX2
+    static __m256i probeMask(uint32_t low)
+    {
+        const __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(BloomFilterConstants::SALTS));
+        __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(low)), salts), 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    }
+#endif
+
+    static unsigned popcount(uint32_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_popcount(word));
+#else
+        unsigned count = 0;
+        for (; word; word &= word - 1)
+            ++count;
+        return count;
+#endif
+    }
+
+    std::vector<Block> blocks;
+    size_t expected;
+    double bitsPerElement;
+    size_t inserted = 0;
+};
+
+// NaiveHashSet with a BlockedBloomFilter in front of contains(): a definite miss costs one
+// cache line of filter instead of a bucket and chain walk. The key is hashed once for both.
+// The filter is rebuilt from the set when the set outgrows it, and once removals
+// (which a Bloom filter cannot forget) outnumber the elements left.
+template <typename T, typename Hasher = std::hash<T>, typename Reduction = ModuloReduction>
+class BloomFilteredHashSet {
+public:
+    explicit BloomFilteredHashSet(double bitsPerElement = BloomFilterConstants::DEFAULT_BITS_PER_ELEMENT)
+        : filter(BloomFilterConstants::MIN_CAPACITY, bitsPerElement)
+    {
+    }
+
+    bool insert(const T& element)
+    {
+        size_t elementHash = set.hashOf(element);
+        if (!set.insert(element, elementHash))
+            return false;
+
+        if (set.size() > filter.capacity())
+            rebuildFilter();
+        else
+            filter.insert(filterHash(elementHash));
+
+        return true;
+    }
+
+    // O(const); a miss usually never reaches the set
+    bool contains(const T& element) const
+    {
+        size_t elementHash = set.hashOf(element);
+        return filter.mayContain(filterHash(elementHash)) && set.contains(element, elementHash);
+    }
+
+    bool remove(const T& element)
+    {
+        if (!set.remove(element))
+            return false;
+
+        if (++staleElements > set.size())
+            rebuildFilter();
+
+        return true;
+    }
+
+    void clear()
+    {
+        set.clear();
+        filter = BlockedBloomFilter(BloomFilterConstants::MIN_CAPACITY, filter.bits_per_element());
+        staleElements = 0;
+    }
+
+    size_t size() const { return set.size(); }
+    bool empty() const { return set.empty(); }
+
+    const BlockedBloomFilter& bloom_filter() const { return filter; }
+
+private:
+    // the container hash may be the identity (std::hash of an integer), the filter needs all 64 bits mixed
+    static uint64_t filterHash(size_t elementHash) { return Hashing::mix64(elementHash); }
+
+    // room for twice the current elements, so rebuilds are amortized O(const) per insert
+    void rebuildFilter()
+    {
+        filter = BlockedBloomFilter(2 * set.size(), filter.bits_per_element());
+        set.for_each([this](const T& element) { filter.insert(filterHash(set.hashOf(element))); });
+        staleElements = 0;
+    }
+
+    NaiveHashSet<T, Hasher, Reduction> set;
+    BlockedBloomFilter filter;
+    size_t staleElements = 0; // removed, but still in the filter
+};
+
+// UnorderedMap with a BlockedBloomFilter in front of get / contains / find, same rebuild policy as above.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>, typename Reduction = ModuloReduction>
+class BloomFilteredUnorderedMap {
+    typedef UnorderedMap<Key, Value, Hasher, Reduction> Map;
+
+public:
+    explicit BloomFilteredUnorderedMap(double bitsPerElement = BloomFilterConstants::DEFAULT_BITS_PER_ELEMENT)
+        : filter(BloomFilterConstants::MIN_CAPACITY, bitsPerElement)
+    {
+    }
+
+    bool insert(const Key& key, const Value& value)
+    {
+        size_t hash = map.hashOf(key);
+        if (!map.insert(key, value, hash).second)
+            return false;
+
+        if (map.size() > filter.capacity())
+            rebuildFilter();
+        else
+            filter.insert(filterHash(hash));
+
+        return true;
+    }
+
+    // returns cend() if there is no such key
+    typename Map::ConstDataListIterator find(const Key& key) const
+    {
+        size_t hash = map.hashOf(key);
+        if (!filter.mayContain(filterHash(hash)))
+            return map.cend();
+
+        return map.find(key, hash);
+    }
+
+    bool contains(const Key& key) const { return find(key) != map.cend(); }
+
+    const Value& get(const Key& key) const
+    {
+        auto iter = find(key);
+        if (iter == map.cend())
+            throw std::runtime_error("Element not found");
+
+        return iter->second;
+    }
+
+    bool remove(const Key& key)
+    {
+        if (!map.remove(key))
+            return false;
+
+        if (++staleElements > map.size())
+            rebuildFilter();
+
+        return true;
+    }
+
+    void clear()
+    {
+        map.clear();
+        filter = BlockedBloomFilter(BloomFilterConstants::MIN_CAPACITY, filter.bits_per_element());
+        staleElements = 0;
+    }
+
+    size_t size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+
+    typename Map::ConstDataListIterator cbegin() const { return map.cbegin(); }
+    typename Map::ConstDataListIterator cend() const { return map.cend(); }
+
+    const BlockedBloomFilter& bloom_filter() const { return filter; }
+
+private:
+    static uint64_t filterHash(size_t hash) { return Hashing::mix64(hash); }
+
+    void rebuildFilter()
+    {
+        filter = BlockedBloomFilter(2 * map.size(), filter.bits_per_element());
+        for (auto iter = map.cbegin(); iter != map.cend(); ++iter)
+            filter.insert(filterHash(map.hashOf(iter->first)));
+        staleElements = 0;
+    }
+
+    Map map;
+    BlockedBloomFilter filter;
+    size_t staleElements = 0;
+};
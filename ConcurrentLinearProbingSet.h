@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "HashFunctions.h"
+
+namespace ConcurrentLinearProbingConstants {
+constexpr size_t INIT_CAPACITY = 1024;
+// plain linear probing, so it is kept sparser than the Robin Hood set
+constexpr double LOAD_FACTOR = 0.5;
+constexpr size_t GROWTH_FACTOR = 2;
+constexpr size_t MIGRATION_CHUNK = 4096; // slots a thread claims at once while moving to a new table
+constexpr size_t COUNTER_STRIPES = 32;
+constexpr size_t CACHE_LINE_SIZE = 64;
+};
+
+// Insert-only lock-free set of 32 / 64 bit integers (e.g. deduplicating IDs from every core at once).
+// A slot is a bare atomic key, claimed with one CAS from EMPTY_KEY; two values of the type are reserved:
+// EMPTY_KEY (the maximum) and MOVED_KEY (the maximum - 1) which seals a slot of a table being migrated.
+//   - contains() never writes and never waits: it probes until the key or EMPTY_KEY,
+//     and follows a MOVED_KEY into the next table.
+//   - Growing is cooperative: the table that got too full gets a successor twice its size,
+//     and every thread that runs into a sealed slot claims chunks of the old table and copies them over
+//     (EMPTY_KEY slots are sealed with MOVED_KEY, so nothing can be added behind the copy)
+//     before continuing in the new table.
+//   - The element count is split over cache line sized stripes, so inserts from different threads
+//     do not all hit one counter.
+// Tables that were moved out of are kept until the set is destroyed (at most as much memory as the current one),
+// since a reader may still be probing them.
+template <typename T, typename Hasher = std::hash<T>>
+class ConcurrentLinearProbingSet {
+    static_assert(std::is_integral_v<T> && (sizeof(T) == 4 || sizeof(T) == 8), "Keys must be 32 or 64 bit integers");
+    static_assert(std::atomic<T>::is_always_lock_free, "Keys must be lock free atomics");
+
+    struct alignas(ConcurrentLinearProbingConstants::CACHE_LINE_SIZE) Counter {
+        std::atomic<size_t> value { 0 };
+    };
+
+    struct Table {
+        explicit Table(size_t capacity)
+            : slots(new std::atomic<T>[capacity])
+            , capacity(capacity)
+            , mask(capacity - 1)
+        {
+            for (size_t i = 0; i < capacity; ++i)
+                slots[i].store(EMPTY_KEY, std::memory_order_relaxed);
+        }
+
+        std::unique_ptr<std::atomic<T>[]> slots;
+        size_t capacity; // a power of two
+        size_t mask;
+        Counter counters[ConcurrentLinearProbingConstants::COUNTER_STRIPES];
+
+        std::atomic<Table*> next { nullptr };
+        std::atomic<bool> growing { false }; // somebody is allocating next
+        std::atomic<size_t> nextChunk { 0 };
+        std::atomic<size_t> chunksDone { 0 };
+    };
+
+    enum class ProbeResult {
+        INSERTED,
+        EXISTS,
+        SEALED // met a MOVED_KEY, or no free slot left
+    };
+
+public:
+    static constexpr T EMPTY_KEY = std::numeric_limits<T>::max();
+    static constexpr T MOVED_KEY = std::numeric_limits<T>::max() - 1;
+
+    explicit ConcurrentLinearProbingSet(size_t expectedElements = 0)
+    {
+        size_t capacity = ConcurrentLinearProbingConstants::INIT_CAPACITY;
+        while (static_cast<double>(expectedElements) >= ConcurrentLinearProbingConstants::LOAD_FACTOR * capacity)
+            capacity *= ConcurrentLinearProbingConstants::GROWTH_FACTOR;
+
+        first = new Table(capacity);
+        current.store(first, std::memory_order_release);
+    }
+
+    ConcurrentLinearProbingSet(const ConcurrentLinearProbingSet&) = delete;
+    ConcurrentLinearProbingSet& operator=(const ConcurrentLinearProbingSet&) = delete;
+
+    // nobody may be using the set any more by the time it is destroyed
+    ~ConcurrentLinearProbingSet()
+    {
+        for (Table* table = first; table;) {
+            Table* next = table->next.load(std::memory_order_relaxed);
+            delete table;
+            table = next;
+        }
+    }
+
+    // lock free outside of migrations (which it helps finish); returns whether key was new
+    bool insert(T key)
+    {
+        if (key == EMPTY_KEY || key == MOVED_KEY)
+            throw std::invalid_argument("The two largest values of the key type are reserved by the set");
+
+        uint64_t hash = hashOf(key);
+        Table* table = current.load(std::memory_order_acquire);
+
+        for (;;) {
+            switch (probeInsert(*table, key, hash)) {
+            case ProbeResult::INSERTED:
+                countInsert(*table);
+                return true;
+            case ProbeResult::EXISTS:
+                return false;
+            case ProbeResult::SEALED:
+                startGrowing(*table);
+                table = helpMigrate(*table);
+                break;
+            }
+        }
+    }
+
+    // wait free: bounded by the slots of the tables on the way, never blocks on other threads
+    bool contains(T key) const
+    {
+        if (key == EMPTY_KEY || key == MOVED_KEY)
+            return false;
+
+        uint64_t hash = hashOf(key);
+
+        for (const Table* table = current.load(std::memory_order_acquire); table;) {
+            size_t index = hash & table->mask;
+            const Table* next = nullptr;
+
+            for (size_t probe = 0; probe < table->capacity; ++probe, index = (index + 1) & table->mask) {
+                T resident = table->slots[index].load(std::memory_order_acquire);
+
+                if (resident == key)
+                    return true;
+                if (resident == EMPTY_KEY)
+                    return false;
+                if (resident == MOVED_KEY) {
+                    next = table->next.load(std::memory_order_acquire);
+                    break;
+                }
+            }
+
+            // a full table without the key has a successor as well
+            table = next ? next : table->next.load(std::memory_order_acquire);
+        }
+
+        return false;
+    }
+
+    // exact when no insert is running, otherwise a value somewhere between the sizes before and after
+    size_t size() const
+    {
+        const Table* table = current.load(std::memory_order_acquire);
+        return countOf(*table);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return current.load(std::memory_order_acquire)->capacity; }
+
+private:
+    // linear probing takes the home slot from the low bits, so they have to be well mixed
+    uint64_t hashOf(T key) const { return Hashing::mix64(hasher(key)); }
+
+    static size_t countOf(const Table& table)
+    {
+        size_t total = 0;
+        for (const Counter& counter : table.counters)
+            total += counter.value.load(std::memory_order_relaxed);
+
+        return total;
+    }
+
+    // every thread sticks to one stripe
+    static Counter& stripeOf(Table& table)
+    {
+        static std::atomic<size_t> nextStripe { 0 };
+        thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % ConcurrentLinearProbingConstants::COUNTER_STRIPES;
+
+        return table.counters[stripe];
+    }
+
+    static ProbeResult probeInsert(Table& table, T key, uint64_t hash)
+    {
+        size_t index = hash & table.mask;
+
+        for (size_t probe = 0; probe < table.capacity; ++probe, index = (index + 1) & table.mask) {
+            T resident = table.slots[index].load(std::memory_order_acquire);
+
+            if (resident == EMPTY_KEY) {
+                if (table.slots[index].compare_exchange_strong(resident, key, std::memory_order_acq_rel))
+                    return ProbeResult::INSERTED;
+                // lost the slot: resident now holds whoever won it
+            }
+
+            if (resident == key)
+                return ProbeResult::EXISTS;
+            if (resident == MOVED_KEY)
+                return ProbeResult::SEALED;
+        }
+
+        return ProbeResult::SEALED;
+    }
+
+    // Only the thread's own stripe is read on every insert; the exact (all stripes) count is taken
+    // once that stripe alone has used up its share of the load budget.
+    void countInsert(Table& table)
+    {
+        size_t budget = static_cast<size_t>(ConcurrentLinearProbingConstants::LOAD_FACTOR * table.capacity);
+        size_t stripeCount = stripeOf(table).value.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        if (stripeCount * ConcurrentLinearProbingConstants::COUNTER_STRIPES < budget || countOf(table) < budget)
+            return;
+
+        startGrowing(table);
+        helpMigrate(table);
+    }
+
+    // one thread allocates the successor, the others wait for it to appear
+    void startGrowing(Table& table)
+    {
+        if (table.next.load(std::memory_order_acquire))
+            return;
+
+        bool expected = false;
+        if (table.growing.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            table.next.store(new Table(table.capacity * ConcurrentLinearProbingConstants::GROWTH_FACTOR), std::memory_order_release);
+            return;
+        }
+
+        while (!table.next.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    // copies chunks of table into its successor until none are left, waits for the ones other threads took,
+    // and makes the successor current; returns it
+    Table* helpMigrate(Table& table)
+    {
+        Table* next = table.next.load(std::memory_order_acquire);
+        size_t chunks = (table.capacity + ConcurrentLinearProbingConstants::MIGRATION_CHUNK - 1) / ConcurrentLinearProbingConstants::MIGRATION_CHUNK;
+
+        for (size_t chunk = table.nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < chunks;
+             chunk = table.nextChunk.fetch_add(1, std::memory_order_relaxed)) {
+            migrateChunk(table, *next, chunk);
+            table.chunksDone.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        while (table.chunksDone.load(std::memory_order_acquire) < chunks)
+            std::this_thread::yield();
+
+        Table* expected = &table;
+        current.compare_exchange_strong(expected, next, std::memory_order_acq_rel);
+
+        return next;
+    }
+
+    void migrateChunk(Table& table, Table& next, size_t chunk)
+    {
+        size_t begin = chunk * ConcurrentLinearProbingConstants::MIGRATION_CHUNK;
+        size_t end = std::min(begin + ConcurrentLinearProbingConstants::MIGRATION_CHUNK, table.capacity);
+        size_t copied = 0;
+
+        for (size_t index = begin; index < end; ++index) {
+            T resident = table.slots[index].load(std::memory_order_acquire);
+
+            // seal empty slots; a key that wins the race for one is copied instead
+            while (resident == EMPTY_KEY && !table.slots[index].compare_exchange_weak(resident, MOVED_KEY, std::memory_order_acq_rel)) { }
+
+            if (resident != EMPTY_KEY && resident != MOVED_KEY)
+                copied += probeInsert(next, resident, hashOf(resident)) == ProbeResult::INSERTED;
+        }
+
+        stripeOf(next).value.fetch_add(copied, std::memory_order_relaxed);
+    }
+
+    std::atomic<Table*> current;
+    Table* first; // the tables form a list through next, freed in the destructor
+    Hasher hasher;
+};
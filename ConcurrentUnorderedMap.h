@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include "HashFunctions.h"
+#include "UnorderedMap.h"
+
+namespace ConcurrentMapConstants {
+constexpr size_t DEFAULT_SHARD_COUNT = 64;
+constexpr size_t CACHE_LINE_SIZE = 64;
+};
+
+// Thread-safe map: the key space is split into shards, each one an UnorderedMap
+// behind its own reader-writer lock. Every shard sits on its own cache line(s),
+// so threads working on different shards never share a lock word.
+// The key is hashed once - the same hash picks the shard and is passed down to the shard's map.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>, typename Reduction = ModuloReduction>
+class ConcurrentUnorderedMap {
+    struct alignas(ConcurrentMapConstants::CACHE_LINE_SIZE) Shard {
+        mutable std::shared_mutex lock;
+        UnorderedMap<Key, Value, Hasher, Reduction> map;
+    };
+
+public:
+    explicit ConcurrentUnorderedMap(size_t shardCount = ConcurrentMapConstants::DEFAULT_SHARD_COUNT)
+        : shards(new Shard[shardCount > 0 ? shardCount : 1])
+        , shardCount(shardCount > 0 ? shardCount : 1)
+    {
+    }
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap&) = delete;
+    ConcurrentUnorderedMap& operator=(const ConcurrentUnorderedMap&) = delete;
+
+    // returns true if the key was inserted, false if an existing value was overwritten
+    bool insert_or_assign(const Key& key, const Value& value)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+        std::pair<typename UnorderedMap<Key, Value, Hasher, Reduction>::DataListIterator, bool> result = shard.map.insert(key, value, hash);
+        if (!result.second)
+            result.first->second = value;
+
+        return result.second;
+    }
+
+    // returns the value for key; if there is none, factory() is called (under the shard's write lock,
+    // so exactly once per key) and its result is inserted
+    template <typename Factory>
+    Value compute_if_absent(const Key& key, Factory&& factory)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+
+        {
+            std::shared_lock<std::shared_mutex> guard(shard.lock);
+            auto iter = constMap(shard).find(key, hash);
+            if (iter != constMap(shard).cend())
+                return iter->second;
+        }
+
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+        // somebody may have inserted it between the two locks
+        auto iter = shard.map.find(key, hash);
+        if (iter != shard.map.end())
+            return iter->second;
+
+        return shard.map.insert(key, factory(), hash).first->second;
+    }
+
+    // copies the value out, since another thread may erase it right after the lock is released
+    bool get(const Key& key, Value& result) const
+    {
+        size_t hash = hasher(key);
+        const Shard& shard = shardFor(hash);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+
+        auto iter = shard.map.find(key, hash);
+        if (iter == shard.map.cend())
+            return false;
+
+        result = iter->second;
+        return true;
+    }
+
+    bool contains(const Key& key) const
+    {
+        size_t hash = hasher(key);
+        const Shard& shard = shardFor(hash);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+
+        return shard.map.contains(key, hash);
+    }
+
+    bool erase(const Key& key)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+        return shard.map.remove(key, hash);
+    }
+
+    // fn(key, value) sees every shard in a consistent state (the shard is read locked while it is visited),
+    // but different shards are visited at different moments
+    template <typename Function>
+    void for_each(Function&& fn) const
+    {
+        for (size_t i = 0; i < shardCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+
+            for (auto iter = shards[i].map.cbegin(); iter != shards[i].map.cend(); ++iter)
+                fn(iter->first, iter->second);
+        }
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < shardCount; ++i) {
+            std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+            shards[i].map.clear();
+        }
+    }
+
+    // the shards are counted one at a time, so under concurrent writes this is approximate
+    size_t size() const
+    {
+        size_t total = 0;
+
+        for (size_t i = 0; i < shardCount; ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+            total += shards[i].map.size();
+        }
+
+        return total;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t shard_count() const { return shardCount; }
+
+private:
+    // the shard's map uses hash % buckets itself, so the shard is picked from mixed bits
+    Shard& shardFor(size_t hash) const
+    {
+        return shards[Hashing::mix64(hash) % shardCount];
+    }
+
+    static const UnorderedMap<Key, Value, Hasher, Reduction>& constMap(const Shard& shard) { return shard.map; }
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCount;
+
+    Hasher hasher;
+};
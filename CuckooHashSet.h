@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "HashFunctions.h"
+
+namespace CuckooConstants {
+constexpr size_t SLOTS_PER_BUCKET = 4;
+constexpr size_t INIT_BUCKET_COUNT = 4;
+constexpr size_t MAX_KICKS = 500;
+constexpr size_t CACHE_LINE_SIZE = 64;
+// 4-way buckets keep inserts cheap up to ~95% load
+constexpr double MAX_LOAD_FACTOR = 0.93;
+// elements that found no slot wait in a small stash; only a stash longer than this makes the table grow,
+// and only if the table is at least MIN_GROW_LOAD_FACTOR full - below that the misses come from colliding hashes,
+// which no table size can separate, so those elements just stay in the stash
+constexpr size_t STASH_SIZE = 4;
+constexpr double MIN_GROW_LOAD_FACTOR = 0.5;
+};
+
+// Cuckoo hashing with two candidate buckets of 4 slots each:
+// an element is always in one of its two buckets, so a lookup is at most two bucket reads,
+// no matter how full the table is or how unlucky the keys are.
+// Every slot also has a one byte fingerprint of the hash, so keys are only compared when it matches.
+// A bucket never straddles two cache lines.
+// Inserts kick elements to their other bucket when both are full; an element that does not settle in
+// MAX_KICKS moves goes to the stash (checked by lookups only while it is not empty).
+template <typename T, typename Hasher = std::hash<T>>
+class CuckooHashSet {
+    // tags, padding up to T, slots
+    static constexpr size_t BUCKET_BYTES = (CuckooConstants::SLOTS_PER_BUCKET + alignof(T) - 1) / alignof(T) * alignof(T)
+        + CuckooConstants::SLOTS_PER_BUCKET * sizeof(T);
+
+    // a power of two at least the bucket size, so a bucket never straddles two cache lines
+    // (while a small one still shares its line with its neighbours instead of being padded to the full line)
+    static constexpr size_t BUCKET_ALIGNMENT = BUCKET_BYTES <= CuckooConstants::CACHE_LINE_SIZE
+        ? Hashing::roundUpToPowerOfTwo(BUCKET_BYTES)
+        : alignof(T);
+
+    struct alignas(BUCKET_ALIGNMENT) Bucket {
+        uint8_t tags[CuckooConstants::SLOTS_PER_BUCKET]; // 0 means the slot is empty
+        alignas(T) unsigned char storage[CuckooConstants::SLOTS_PER_BUCKET * sizeof(T)];
+
+        T* slot(size_t index) { return reinterpret_cast<T*>(storage) + index; }
+        const T* slot(size_t index) const { return reinterpret_cast<const T*>(storage) + index; }
+    };
+
+public:
+    CuckooHashSet()
+    {
+        allocate(CuckooConstants::INIT_BUCKET_COUNT);
+    }
+
+    CuckooHashSet(const CuckooHashSet& other)
+        : hash(other.hash)
+    {
+        copy(other);
+    }
+
+    CuckooHashSet& operator=(const CuckooHashSet& other)
+    {
+        if (this != &other) {
+            free();
+            hash = other.hash;
+            copy(other);
+        }
+        return *this;
+    }
+
+    CuckooHashSet(CuckooHashSet&& other) noexcept { move(std::move(other)); }
+
+    CuckooHashSet& operator=(CuckooHashSet&& other) noexcept
+    {
+        if (this != &other) {
+            free();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~CuckooHashSet() { free(); }
+
+    void clear()
+    {
+        free();
+        allocate(CuckooConstants::INIT_BUCKET_COUNT);
+    }
+
+    size_t size() const { return sz; }
+
+    bool empty() const { return sz == 0; }
+
+    size_t bucket_count() const { return bucketCount; }
+    double load_factor() const { return static_cast<double>(sz) / (bucketCount * CuckooConstants::SLOTS_PER_BUCKET); }
+
+    // amortized O(const)
+    bool insert(const T& element) { return insert(T(element)); }
+
+    // amortized O(const)
+    bool insert(T&& element)
+    {
+        if (contains(element))
+            return false;
+
+        if (bucketCount == 0) // moved-from
+            allocate(CuckooConstants::INIT_BUCKET_COUNT);
+
+        if (sz + 1 > CuckooConstants::MAX_LOAD_FACTOR * bucketCount * CuckooConstants::SLOTS_PER_BUCKET)
+            grow();
+
+        T carried(std::move(element));
+        ++sz;
+
+        if (!place(carried)) {
+            stash.push_back(std::move(carried)); // whichever element was left without a slot
+
+            if (stash.size() > CuckooConstants::STASH_SIZE && load_factor() >= CuckooConstants::MIN_GROW_LOAD_FACTOR)
+                grow();
+        }
+
+        return true;
+    }
+
+    // O(const) worst case: two buckets
+    bool contains(const T& element) const
+    {
+        if (empty())
+            return false;
+
+        size_t elementHash = hashOf(element);
+        uint8_t elementTag = tagOf(elementHash);
+
+        size_t first = firstBucket(elementHash);
+        return findInBucket(buckets[first], element, elementTag) != CuckooConstants::SLOTS_PER_BUCKET
+            || findInBucket(buckets[secondBucket(elementHash, first)], element, elementTag) != CuckooConstants::SLOTS_PER_BUCKET
+            || (!stash.empty() && findInStash(element) != stash.size());
+    }
+
+    // O(const) worst case: two buckets
+    bool remove(const T& element)
+    {
+        if (empty())
+            return false;
+
+        size_t elementHash = hashOf(element);
+        uint8_t elementTag = tagOf(elementHash);
+
+        size_t first = firstBucket(elementHash);
+        size_t candidates[2] = { first, secondBucket(elementHash, first) };
+
+        for (size_t bucketIndex : candidates) {
+            Bucket& bucket = buckets[bucketIndex];
+            size_t slotIndex = findInBucket(bucket, element, elementTag);
+
+            if (slotIndex != CuckooConstants::SLOTS_PER_BUCKET) {
+                bucket.slot(slotIndex)->~T();
+                bucket.tags[slotIndex] = 0;
+                --sz;
+                return true;
+            }
+        }
+
+        size_t stashIndex = findInStash(element);
+        if (stashIndex == stash.size())
+            return false;
+
+        stash[stashIndex] = std::move(stash.back());
+        stash.pop_back();
+        --sz;
+        return true;
+    }
+
+    size_t stash_size() const { return stash.size(); }
+
+private:
+    // std::hash of an integer is the identity, so the bits are mixed before picking buckets
+    size_t hashOf(const T& element) const
+    {
+        return static_cast<size_t>(Hashing::mix64(hash(element)));
+    }
+
+    static uint8_t tagOf(size_t elementHash)
+    {
+        uint8_t tag = static_cast<uint8_t>(elementHash >> 56);
+        return tag != 0 ? tag : 1;
+    }
+
+    size_t firstBucket(size_t elementHash) const
+    {
+        return elementHash & (bucketCount - 1);
+    }
+
+    // taken from other bits than the first one, and never equal to it
+    size_t secondBucket(size_t elementHash, size_t first) const
+    {
+        size_t second = (elementHash >> 32) & (bucketCount - 1);
+        return second != first ? second : first ^ 1;
+    }
+
+    static size_t findInBucket(const Bucket& bucket, const T& element, uint8_t elementTag)
+    {
+        for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i)
+            if (bucket.tags[i] == elementTag && *bucket.slot(i) == element)
+                return i;
+
+        return CuckooConstants::SLOTS_PER_BUCKET;
+    }
+
+    // returns stash.size() if element is not there
+    size_t findInStash(const T& element) const
+    {
+        size_t index = 0;
+        while (index < stash.size() && !(stash[index] == element))
+            ++index;
+
+        return index;
+    }
+
+    bool tryPlaceInBucket(Bucket& bucket, T& element, uint8_t elementTag)
+    {
+        for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i) {
+            if (bucket.tags[i] == 0) {
+                new (bucket.slot(i)) T(std::move(element));
+                bucket.tags[i] = elementTag;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Puts element into one of its buckets, kicking residents to their other bucket if needed.
+    // On failure element holds the one element that is still homeless (all the others are in the table).
+    bool place(T& element)
+    {
+        size_t elementHash = hashOf(element);
+        uint8_t elementTag = tagOf(elementHash);
+        size_t bucketIndex = firstBucket(elementHash);
+
+        if (tryPlaceInBucket(buckets[bucketIndex], element, elementTag))
+            return true;
+
+        bucketIndex = secondBucket(elementHash, bucketIndex);
+
+        for (size_t kick = 0; kick < CuckooConstants::MAX_KICKS; ++kick) {
+            Bucket& bucket = buckets[bucketIndex];
+
+            if (tryPlaceInBucket(bucket, element, elementTag))
+                return true;
+
+            // swap with a pseudo random resident and move on to the resident's other bucket
+            size_t victim = nextRandom() % CuckooConstants::SLOTS_PER_BUCKET;
+            std::swap(element, *bucket.slot(victim));
+            std::swap(elementTag, bucket.tags[victim]);
+
+            elementHash = hashOf(element);
+            size_t first = firstBucket(elementHash);
+            bucketIndex = first != bucketIndex ? first : secondBucket(elementHash, first);
+        }
+
+        return false;
+    }
+
+    size_t nextRandom()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 7;
+        randomState ^= randomState << 17;
+        return static_cast<size_t>(randomState);
+    }
+
+    // O(n); whatever still finds no slot (including the old stash) ends up in the new stash
+    void grow()
+    {
+        Bucket* oldBuckets = buckets;
+        size_t oldBucketCount = bucketCount;
+        std::vector<T> oldStash;
+        oldStash.swap(stash);
+
+        allocate(bucketCount * 2);
+
+        for (size_t b = 0; b < oldBucketCount; ++b) {
+            for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i) {
+                if (oldBuckets[b].tags[i] == 0)
+                    continue;
+
+                T element(std::move(*oldBuckets[b].slot(i)));
+                oldBuckets[b].slot(i)->~T();
+
+                if (!place(element))
+                    stash.push_back(std::move(element));
+            }
+        }
+
+        deallocate(oldBuckets, oldBucketCount);
+
+        for (T& element : oldStash)
+            if (!place(element))
+                stash.push_back(std::move(element));
+    }
+
+    void allocate(size_t count)
+    {
+        buckets = static_cast<Bucket*>(::operator new(count * sizeof(Bucket), std::align_val_t(alignof(Bucket))));
+
+        for (size_t b = 0; b < count; ++b)
+            for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i)
+                buckets[b].tags[i] = 0;
+
+        bucketCount = count;
+    }
+
+    static void deallocate(Bucket* toDelete, size_t)
+    {
+        ::operator delete(toDelete, std::align_val_t(alignof(Bucket)));
+    }
+
+    void destroyAll()
+    {
+        for (size_t b = 0; b < bucketCount; ++b)
+            for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i)
+                if (buckets[b].tags[i] != 0)
+                    buckets[b].slot(i)->~T();
+    }
+
+    void copy(const CuckooHashSet& other)
+    {
+        allocate(other.bucketCount);
+
+        for (size_t b = 0; b < bucketCount; ++b) {
+            for (size_t i = 0; i < CuckooConstants::SLOTS_PER_BUCKET; ++i) {
+                if (other.buckets[b].tags[i] != 0) {
+                    new (buckets[b].slot(i)) T(*other.buckets[b].slot(i));
+                    buckets[b].tags[i] = other.buckets[b].tags[i];
+                }
+            }
+        }
+
+        stash = other.stash;
+        sz = other.sz;
+    }
+
+    void move(CuckooHashSet&& other)
+    {
+        buckets = other.buckets;
+        bucketCount = other.bucketCount;
+        sz = other.sz;
+        stash = std::move(other.stash);
+        hash = std::move(other.hash);
+
+        other.stash.clear();
+        other.buckets = nullptr;
+        other.bucketCount = 0;
+        other.sz = 0;
+    }
+
+    void free()
+    {
+        if (!buckets)
+            return;
+
+        destroyAll();
+        deallocate(buckets, bucketCount);
+        stash.clear();
+
+        buckets = nullptr;
+        bucketCount = 0;
+        sz = 0;
+    }
+
+    Bucket* buckets = nullptr;
+    size_t bucketCount = 0;
+    size_t sz = 0; // stash included
+    std::vector<T> stash;
+
+    Hasher hash;
+    uint64_t randomState = 0x2545f4914f6cdd1dULL;
+};
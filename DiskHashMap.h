@@ -0,0 +1,455 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HashFunctions.h"
+
+namespace DiskHashMapConstants {
+constexpr char MAGIC[8] = { 'D', 'I', 'S', 'K', 'H', 'M', 'A', 'P' };
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304; // reads differently on a machine of the other endianness
+constexpr size_t PAGE_SIZE = 4096;
+constexpr size_t INIT_BUCKET_COUNT = 16;
+// split one more bucket once the entries would fill this much of one page per bucket
+constexpr double MAX_LOAD = 0.8;
+// bucket groups: the initial buckets, then one group per doubling of the bucket count
+constexpr size_t MAX_GROUPS = 48;
+constexpr uint64_t NO_PAGE = 0; // page 0 is the header, so it is never a bucket or overflow page
+};
+
+// Page 0 of the file. The other pages are bucket pages and their overflow pages.
+struct DiskHashHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    // layout of the writer's entries, catches opening the file with other Key / Value types
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t entrySize;
+    uint64_t pageSize;
+    uint64_t count;
+    uint64_t level; // INIT_BUCKET_COUNT << level buckets at the start of this round of splits
+    uint64_t splitPointer; // the next bucket to split, buckets before it are split already in this round
+    uint64_t pageCount; // pages handed out so far, including the reserved (and maybe still untouched) bucket pages
+    uint64_t freePage; // head of the freed overflow pages, linked through their overflow field
+    // first page of each bucket group: group 0 holds the initial buckets,
+    // group g > 0 the INIT_BUCKET_COUNT << (g - 1) buckets created in round g - 1
+    uint64_t groupStart[DiskHashMapConstants::MAX_GROUPS];
+};
+
+struct DiskHashPageHeader {
+    uint64_t overflow; // next page of the same bucket, or NO_PAGE
+    uint64_t count;
+};
+
+template <typename Key, typename Value>
+struct DiskHashEntry {
+    uint64_t hash;
+    Key key;
+    Value value;
+};
+
+// Hash map whose buckets live in a memory mapped file, for indexes bigger than RAM: the kernel pages
+// them in and out on demand, so only the pages in use take memory.
+//   - A bucket is one fixed size page of entries, plus a chain of overflow pages when it does not fit.
+//   - Linear hashing: the map grows by splitting one bucket at a time (the one the split pointer is at),
+//     never by rehashing everything, so an insert touches at most a couple of buckets.
+//     The pages of a whole round of splits are reserved at once at the end of the file,
+//     which keeps bucket -> page pure arithmetic; they stay sparse (no disk space) until written.
+//   - Changes reach the file whenever the kernel writes the pages back; flush() forces that (msync).
+//     A crash between flushes can leave the file inconsistent.
+// Keys and values are stored as raw bytes, so both must be trivially copyable, and keys are hashed
+// and compared by their bytes (Hashing::hashBytes, the same in every build). Not thread safe.
+template <typename Key, typename Value>
+class DiskHashMap {
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>, "DiskHashMap stores trivially copyable types only");
+    static_assert(std::has_unique_object_representations_v<Key>, "Disk hash keys must be compared by their bytes");
+
+    typedef DiskHashEntry<Key, Value> Entry;
+    static_assert(sizeof(DiskHashHeader) <= DiskHashMapConstants::PAGE_SIZE, "The header must fit into one page");
+    static_assert(alignof(Entry) <= alignof(DiskHashPageHeader), "Over-aligned keys or values");
+
+    static constexpr size_t ENTRIES_PER_PAGE = (DiskHashMapConstants::PAGE_SIZE - sizeof(DiskHashPageHeader)) / sizeof(Entry);
+    static_assert(ENTRIES_PER_PAGE > 0, "An entry must fit into one page");
+
+public:
+    // opens the map in path, or creates it there if the file does not exist or is empty
+    explicit DiskHashMap(const std::string& path)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+
+        try {
+            struct stat status;
+            if (::fstat(fd, &status) != 0)
+                throw std::runtime_error("Cannot open " + path);
+
+            if (status.st_size == 0) {
+                create();
+            } else {
+                map(static_cast<size_t>(status.st_size));
+                validate();
+            }
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    DiskHashMap(const DiskHashMap&) = delete;
+    DiskHashMap& operator=(const DiskHashMap&) = delete;
+
+    DiskHashMap(DiskHashMap&& other) noexcept { move(std::move(other)); }
+
+    DiskHashMap& operator=(DiskHashMap&& other) noexcept
+    {
+        if (this != &other) {
+            unmap();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    // does not flush, the kernel still writes the pages back at its own pace
+    ~DiskHashMap() { unmap(); }
+
+    // O(const) pages; returns false if the key was already there (its value is kept)
+    bool insert(const Key& key, const Value& value)
+    {
+        uint64_t hash = hashOf(key);
+        uint64_t bucket = bucketOf(hash);
+
+        if (locate(bucket, hash, key).page != DiskHashMapConstants::NO_PAGE)
+            return false;
+
+        Entry entry {}; // zeroes the padding too, so the file does not depend on stack garbage
+        entry.hash = hash;
+        entry.key = key;
+        entry.value = value;
+        append(bucket, entry);
+
+        ++header()->count;
+        if (header()->count > DiskHashMapConstants::MAX_LOAD * ENTRIES_PER_PAGE * bucket_count())
+            splitNext();
+
+        return true;
+    }
+
+    // O(const) pages; the value is copied out, since a later insert may move the mapping
+    Value get(const Key& key) const
+    {
+        uint64_t hash = hashOf(key);
+        Location location = locate(bucketOf(hash), hash, key);
+
+        if (location.page == DiskHashMapConstants::NO_PAGE)
+            throw std::runtime_error("Element not found");
+
+        return entriesOf(location.page)[location.slot].value;
+    }
+
+    // O(const) pages; overwrites the value of an existing key
+    void set(const Key& key, const Value& value)
+    {
+        uint64_t hash = hashOf(key);
+        Location location = locate(bucketOf(hash), hash, key);
+
+        if (location.page == DiskHashMapConstants::NO_PAGE)
+            throw std::runtime_error("Element not found");
+
+        entriesOf(location.page)[location.slot].value = value;
+    }
+
+    // O(const) pages
+    bool contains(const Key& key) const
+    {
+        uint64_t hash = hashOf(key);
+        return locate(bucketOf(hash), hash, key).page != DiskHashMapConstants::NO_PAGE;
+    }
+
+    // O(const) pages: the last entry of the bucket fills the hole, and an overflow page left empty is freed
+    // for later overflows. Buckets are never merged back, the file does not shrink.
+    bool remove(const Key& key)
+    {
+        uint64_t hash = hashOf(key);
+        uint64_t bucket = bucketOf(hash);
+        Location location = locate(bucket, hash, key);
+
+        if (location.page == DiskHashMapConstants::NO_PAGE)
+            return false;
+
+        uint64_t previous = DiskHashMapConstants::NO_PAGE;
+        uint64_t last = bucketPage(bucket);
+        while (pageHeader(last)->overflow != DiskHashMapConstants::NO_PAGE) {
+            previous = last;
+            last = pageHeader(last)->overflow;
+        }
+
+        DiskHashPageHeader* lastHeader = pageHeader(last);
+        entriesOf(location.page)[location.slot] = entriesOf(last)[--lastHeader->count];
+
+        if (lastHeader->count == 0 && previous != DiskHashMapConstants::NO_PAGE) {
+            pageHeader(previous)->overflow = DiskHashMapConstants::NO_PAGE;
+            freePage(last);
+        }
+
+        --header()->count;
+        return true;
+    }
+
+    // writes every changed page to the file and waits for it
+    void flush()
+    {
+        if (::msync(base, mappedSize, MS_SYNC) != 0)
+            throw std::runtime_error("Cannot flush the disk hash map");
+    }
+
+    size_t size() const { return static_cast<size_t>(header()->count); }
+    bool empty() const { return size() == 0; }
+
+    size_t bucket_count() const { return static_cast<size_t>(roundSize() + header()->splitPointer); }
+    size_t page_count() const { return static_cast<size_t>(header()->pageCount); }
+    static constexpr size_t entries_per_page() { return ENTRIES_PER_PAGE; }
+
+private:
+    struct Location {
+        uint64_t page; // NO_PAGE if the key is not there
+        size_t slot;
+    };
+
+    static uint64_t hashOf(const Key& key) { return Hashing::hashBytes(&key, sizeof(Key)); }
+
+    DiskHashHeader* header() const { return reinterpret_cast<DiskHashHeader*>(base); }
+
+    DiskHashPageHeader* pageHeader(uint64_t page) const
+    {
+        return reinterpret_cast<DiskHashPageHeader*>(base + page * DiskHashMapConstants::PAGE_SIZE);
+    }
+
+    Entry* entriesOf(uint64_t page) const { return reinterpret_cast<Entry*>(pageHeader(page) + 1); }
+
+    uint64_t roundSize() const { return DiskHashMapConstants::INIT_BUCKET_COUNT << header()->level; }
+
+    // the buckets before the split pointer are split already, so they take one more bit of the hash
+    uint64_t bucketOf(uint64_t hash) const
+    {
+        uint64_t bucket = hash & (roundSize() - 1);
+        if (bucket < header()->splitPointer)
+            bucket = hash & (2 * roundSize() - 1);
+
+        return bucket;
+    }
+
+    uint64_t bucketPage(uint64_t bucket) const
+    {
+        if (bucket < DiskHashMapConstants::INIT_BUCKET_COUNT)
+            return header()->groupStart[0] + bucket;
+
+        // group g holds the buckets [INIT_BUCKET_COUNT << (g - 1), INIT_BUCKET_COUNT << g)
+        unsigned group = 64 - static_cast<unsigned>(__builtin_clzll(bucket / DiskHashMapConstants::INIT_BUCKET_COUNT));
+        return header()->groupStart[group] + bucket - (DiskHashMapConstants::INIT_BUCKET_COUNT << (group - 1));
+    }
+
+    Location locate(uint64_t bucket, uint64_t hash, const Key& key) const
+    {
+        for (uint64_t page = bucketPage(bucket); page != DiskHashMapConstants::NO_PAGE; page = pageHeader(page)->overflow) {
+            const Entry* entries = entriesOf(page);
+            size_t count = static_cast<size_t>(pageHeader(page)->count);
+
+            for (size_t slot = 0; slot < count; ++slot)
+                if (entries[slot].hash == hash && std::memcmp(&entries[slot].key, &key, sizeof(Key)) == 0)
+                    return Location { page, slot };
+        }
+
+        return Location { DiskHashMapConstants::NO_PAGE, 0 };
+    }
+
+    // into the last page of the bucket, or a new overflow page behind it if that one is full
+    void append(uint64_t bucket, const Entry& entry)
+    {
+        uint64_t last = bucketPage(bucket);
+        while (pageHeader(last)->overflow != DiskHashMapConstants::NO_PAGE)
+            last = pageHeader(last)->overflow;
+
+        if (pageHeader(last)->count == ENTRIES_PER_PAGE) {
+            uint64_t overflow = allocatePage(); // may move the mapping, so no pointers are kept across it
+            pageHeader(last)->overflow = overflow;
+            last = overflow;
+        }
+
+        DiskHashPageHeader* lastHeader = pageHeader(last);
+        entriesOf(last)[lastHeader->count++] = entry;
+    }
+
+    // Splits the bucket at the split pointer into itself and its partner one round size higher,
+    // by the next bit of the hash. The first split of a round reserves the pages of all its new buckets.
+    void splitNext()
+    {
+        uint64_t level = header()->level;
+        if (level + 1 >= DiskHashMapConstants::MAX_GROUPS)
+            return; // the buckets just get longer chains
+
+        uint64_t bucket = header()->splitPointer;
+        uint64_t partner = bucket + roundSize();
+        uint64_t mask = 2 * roundSize() - 1;
+
+        if (bucket == 0) {
+            uint64_t groupPages = roundSize();
+            header()->groupStart[level + 1] = header()->pageCount;
+            reservePages(header()->pageCount + groupPages);
+            header()->pageCount += groupPages;
+        }
+
+        std::vector<Entry> entries;
+        uint64_t primary = bucketPage(bucket);
+
+        for (uint64_t page = primary; page != DiskHashMapConstants::NO_PAGE;) {
+            DiskHashPageHeader* current = pageHeader(page);
+            entries.insert(entries.end(), entriesOf(page), entriesOf(page) + current->count);
+
+            uint64_t next = current->overflow;
+            if (page != primary)
+                freePage(page);
+
+            page = next;
+        }
+
+        pageHeader(primary)->overflow = DiskHashMapConstants::NO_PAGE;
+        pageHeader(primary)->count = 0;
+
+        for (const Entry& entry : entries)
+            append((entry.hash & mask) == bucket ? bucket : partner, entry);
+
+        if (++header()->splitPointer == roundSize()) {
+            header()->splitPointer = 0;
+            ++header()->level;
+        }
+    }
+
+    // a freed overflow page if there is one, a new one at the end of the file otherwise
+    uint64_t allocatePage()
+    {
+        uint64_t page = header()->freePage;
+
+        if (page != DiskHashMapConstants::NO_PAGE) {
+            header()->freePage = pageHeader(page)->overflow;
+        } else {
+            page = header()->pageCount;
+            reservePages(page + 1);
+            ++header()->pageCount;
+        }
+
+        *pageHeader(page) = DiskHashPageHeader { DiskHashMapConstants::NO_PAGE, 0 };
+        return page;
+    }
+
+    void freePage(uint64_t page)
+    {
+        *pageHeader(page) = DiskHashPageHeader { header()->freePage, 0 };
+        header()->freePage = page;
+    }
+
+    // the file (and the mapping) grows by doubling, the new part reads as zeroes (empty pages)
+    void reservePages(uint64_t pages)
+    {
+        size_t needed = static_cast<size_t>(pages * DiskHashMapConstants::PAGE_SIZE);
+        if (needed <= mappedSize)
+            return;
+
+        size_t newSize = std::max(needed, 2 * mappedSize);
+        if (::ftruncate(fd, static_cast<off_t>(newSize)) != 0)
+            throw std::runtime_error("Cannot grow the disk hash map file");
+
+        ::munmap(base, mappedSize);
+        base = nullptr;
+        map(newSize);
+    }
+
+    void create()
+    {
+        size_t pages = 1 + DiskHashMapConstants::INIT_BUCKET_COUNT;
+        if (::ftruncate(fd, static_cast<off_t>(pages * DiskHashMapConstants::PAGE_SIZE)) != 0)
+            throw std::runtime_error("Cannot grow the disk hash map file");
+
+        map(pages * DiskHashMapConstants::PAGE_SIZE);
+
+        DiskHashHeader* created = header();
+        std::memcpy(created->magic, DiskHashMapConstants::MAGIC, sizeof(created->magic));
+        created->version = DiskHashMapConstants::FORMAT_VERSION;
+        created->byteOrderMark = DiskHashMapConstants::BYTE_ORDER_MARK;
+        created->keySize = sizeof(Key);
+        created->valueSize = sizeof(Value);
+        created->entrySize = sizeof(Entry);
+        created->pageSize = DiskHashMapConstants::PAGE_SIZE;
+        created->pageCount = pages;
+        created->groupStart[0] = 1;
+    }
+
+    void map(size_t size)
+    {
+        void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error("Cannot map the disk hash map file");
+
+        base = static_cast<char*>(mapping);
+        mappedSize = size;
+    }
+
+    // the structure of the file must be sound, the pages themselves are not checked
+    void validate() const
+    {
+        const DiskHashHeader* candidate = header();
+
+        bool valid = mappedSize >= DiskHashMapConstants::PAGE_SIZE
+            && std::memcmp(candidate->magic, DiskHashMapConstants::MAGIC, sizeof(candidate->magic)) == 0
+            && candidate->version == DiskHashMapConstants::FORMAT_VERSION
+            && candidate->byteOrderMark == DiskHashMapConstants::BYTE_ORDER_MARK
+            && candidate->keySize == sizeof(Key)
+            && candidate->valueSize == sizeof(Value)
+            && candidate->entrySize == sizeof(Entry)
+            && candidate->pageSize == DiskHashMapConstants::PAGE_SIZE
+            && candidate->level + 1 < DiskHashMapConstants::MAX_GROUPS
+            && candidate->pageCount * DiskHashMapConstants::PAGE_SIZE <= mappedSize;
+
+        if (!valid)
+            throw std::runtime_error("Not a disk hash map of these key and value types");
+    }
+
+    void move(DiskHashMap&& other)
+    {
+        fd = other.fd;
+        base = other.base;
+        mappedSize = other.mappedSize;
+
+        other.fd = -1;
+        other.base = nullptr;
+        other.mappedSize = 0;
+    }
+
+    void unmap()
+    {
+        if (base)
+            ::munmap(base, mappedSize);
+        if (fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+        base = nullptr;
+        mappedSize = 0;
+    }
+
+    int fd = -1;
+    char* base = nullptr;
+    size_t mappedSize = 0;
+};
@@ -445,8 +445,58 @@ public:
         return iterator(newNext);
     }
 
-    void pushFront(const T& data) { insertBefore(data, begin()); }
-    void pushBack(const T& data) { insertAfter(data, iterator(tail)); }
+    void pushFront(const T& data)
+    {
+        if (empty()) {
+            head = tail = new Node(data);
+            size = 1;
+            return;
+        }
+
+        insertBefore(data, begin());
+    }
+
+    void pushBack(const T& data)
+    {
+        if (empty()) {
+            head = tail = new Node(data);
+            size = 1;
+            return;
+        }
+
+        insertAfter(data, iterator(tail));
+    }
+
+    // O(const), returns iterator to the element after the removed one
+    iterator remove(iterator iter)
+    {
+        if (iter == end())
+            return end();
+
+        Node* toDelete = iter.current;
+        Node* newNext = toDelete->next;
+
+        unlink(toDelete);
+        delete toDelete;
+        --size;
+
+        return iterator(newNext);
+    }
+
+    // O(const), relinks the node itself, so iterators to it stay valid
+    void moveToFront(iterator iter)
+    {
+        if (iter == end() || iter.current == head)
+            return;
+
+        Node* node = iter.current;
+        unlink(node);
+
+        node->prev = nullptr;
+        node->next = head;
+        head->prev = node;
+        head = node;
+    }
 
     void popFront()
     {
@@ -510,7 +560,7 @@ private:
     {
         const_iterator iter = other.cbegin();
         while (iter != other.cend())
-            pushBack(*iter);
+            pushBack(*(iter++));
     }
 
     void free()
@@ -521,6 +571,23 @@ private:
             current = current->next;
             delete toDelete;
         }
+
+        head = tail = nullptr;
+        size = 0;
+    }
+
+    // detaches the node from its neighbours (and head/tail), does not free it
+    void unlink(Node* node)
+    {
+        if (node->prev)
+            node->prev->next = node->next;
+        else
+            head = node->next;
+
+        if (node->next)
+            node->next->prev = node->prev;
+        else
+            tail = node->prev;
     }
 
     void move(DLL&& other)
@@ -0,0 +1,468 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "HashFunctions.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_MAP_SSE2 1
+#endif
+
+namespace FlatMapConstants {
+constexpr size_t GROUP_SIZE = 16;
+constexpr size_t INIT_CAPACITY = 16;
+// max load factor 7/8 - with 16 wide groups the probe sequences still stay very short
+constexpr size_t MAX_LOAD_NUMERATOR = 7;
+constexpr size_t MAX_LOAD_DENOMINATOR = 8;
+
+constexpr int8_t EMPTY = -128; // 0b10000000
+constexpr int8_t DELETED = -2; // 0b11111110
+// full slots store the low 7 bits of the hash, so they are always in [0, 127]
+};
+
+// Open addressing hash map in the "swiss table" layout:
+// the elements live in one flat slot array and every slot has one control byte
+// (empty / deleted / 7 bits of the hash). A lookup scans 16 control bytes at once
+// (one SSE2 compare) and only touches the slots whose 7 bit fragment matches,
+// so most lookups cost one control byte cache line plus one slot cache line.
+// Same insert/get/modify/contains/remove surface as UnorderedMap.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>>
+class FlatUnorderedMap {
+public:
+    typedef std::pair<Key, Value> DataType;
+
+    FlatUnorderedMap() = default;
+
+    explicit FlatUnorderedMap(size_t initialCapacity)
+    {
+        reserve(initialCapacity);
+    }
+
+    FlatUnorderedMap(const FlatUnorderedMap& other)
+        : hasher(other.hasher)
+    {
+        copy(other);
+    }
+
+    FlatUnorderedMap& operator=(const FlatUnorderedMap& other)
+    {
+        if (this != &other) {
+            free();
+            hasher = other.hasher;
+            copy(other);
+        }
+        return *this;
+    }
+
+    FlatUnorderedMap(FlatUnorderedMap&& other) noexcept { move(std::move(other)); }
+
+    FlatUnorderedMap& operator=(FlatUnorderedMap&& other) noexcept
+    {
+        if (this != &other) {
+            free();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~FlatUnorderedMap() { free(); }
+
+    // Data is DataType for Iterator and const DataType for ConstIterator
+    template <typename Data>
+    class BasicIterator {
+    public:
+        // Iterator converts to ConstIterator, not the other way around
+        template <typename Other, typename = std::enable_if_t<std::is_convertible_v<Other*, Data*>>>
+        BasicIterator(const BasicIterator<Other>& other)
+            : owner(other.owner)
+            , index(other.index)
+        {
+        }
+
+        BasicIterator& operator++()
+        {
+            ++index;
+            skipEmpty();
+            return *this;
+        }
+
+        BasicIterator operator++(int)
+        {
+            BasicIterator temp(*this);
+            ++(*this);
+            return temp;
+        }
+
+        Data& operator*() const { return owner->slots[index]; }
+        Data* operator->() const { return &owner->slots[index]; }
+
+        bool operator==(const BasicIterator& rhs) const { return index == rhs.index; }
+        bool operator!=(const BasicIterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class FlatUnorderedMap;
+        template <typename>
+        friend class BasicIterator;
+
+        BasicIterator(const FlatUnorderedMap* owner, size_t index)
+            : owner(owner)
+            , index(index)
+        {
+            skipEmpty();
+        }
+
+        void skipEmpty()
+        {
+            while (index < owner->cap && !isFull(owner->ctrl[index]))
+                ++index;
+        }
+
+        const FlatUnorderedMap* owner;
+        size_t index;
+    };
+
+    typedef BasicIterator<DataType> Iterator;
+    typedef BasicIterator<const DataType> ConstIterator;
+
+    Iterator begin() { return Iterator(this, 0); }
+    Iterator end() { return Iterator(this, cap); }
+    ConstIterator begin() const { return cbegin(); }
+    ConstIterator end() const { return cend(); }
+    ConstIterator cbegin() const { return ConstIterator(this, 0); }
+    ConstIterator cend() const { return ConstIterator(this, cap); }
+
+    // amortized: O(const)
+    std::pair<Iterator, bool> insert(const Key& key, const Value& value)
+    {
+        size_t hash = hashOf(key);
+        size_t index = findIndex(key, hash);
+
+        if (index != cap)
+            return std::make_pair(Iterator(this, index), false);
+
+        if (sz + deleted >= maxElementsFor(cap))
+            rehashForInsert();
+
+        index = findInsertSlot(hash);
+        new (&slots[index]) DataType(key, value);
+
+        if (ctrl[index] == FlatMapConstants::DELETED)
+            --deleted;
+        ctrl[index] = h2(hash);
+        ++sz;
+
+        return std::make_pair(Iterator(this, index), true);
+    }
+
+    // amortized: O(const)
+    Value& get(const Key& key) const
+    {
+        size_t index = findIndex(key, hashOf(key));
+        if (index == cap)
+            throw std::runtime_error("Element not found");
+
+        return slots[index].second;
+    }
+
+    // amortized: O(const)
+    Value& modify(const Key& key)
+    {
+        return get(key);
+    }
+
+    // amortized: O(const)
+    bool contains(const Key& key) const
+    {
+        return findIndex(key, hashOf(key)) != cap;
+    }
+
+    // amortized: O(const)
+    bool remove(const Key& key)
+    {
+        size_t index = findIndex(key, hashOf(key));
+        if (index == cap)
+            return false;
+
+        slots[index].~DataType();
+        --sz;
+
+        // a probe only continues past a group that has no empty slot,
+        // so if this group still has one nobody can be relying on this slot - no tombstone needed
+        size_t groupStart = index & ~(FlatMapConstants::GROUP_SIZE - 1);
+        if (matchEmpty(groupStart) != 0) {
+            ctrl[index] = FlatMapConstants::EMPTY;
+        } else {
+            ctrl[index] = FlatMapConstants::DELETED;
+            ++deleted;
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        destroyAll();
+
+        if (ctrl)
+            std::memset(ctrl, static_cast<unsigned char>(FlatMapConstants::EMPTY), cap);
+
+        sz = deleted = 0;
+    }
+
+    bool empty() const { return sz == 0; }
+    size_t size() const { return sz; }
+    double load_factor() const { return static_cast<double>(FlatMapConstants::MAX_LOAD_NUMERATOR) / FlatMapConstants::MAX_LOAD_DENOMINATOR; }
+    size_t bucket_count() const { return cap; }
+
+    // makes room for count elements without any further rehash
+    void reserve(size_t count)
+    {
+        size_t newCapacity = FlatMapConstants::INIT_CAPACITY;
+        while (maxElementsFor(newCapacity) <= count)
+            newCapacity *= 2;
+
+        if (newCapacity > cap)
+            resize(newCapacity);
+    }
+
+    // O(n), newCapacity is rounded up to a power of two (at least one group)
+    void resize(size_t newCapacity)
+    {
+        size_t roundedCapacity = FlatMapConstants::INIT_CAPACITY;
+        while (roundedCapacity < newCapacity)
+            roundedCapacity *= 2;
+
+        if (maxElementsFor(roundedCapacity) <= sz)
+            throw std::logic_error("Cannot resize below the current number of elements");
+
+        int8_t* oldCtrl = ctrl;
+        DataType* oldSlots = slots;
+        size_t oldCapacity = cap;
+
+        allocate(roundedCapacity);
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (!isFull(oldCtrl[i]))
+                continue;
+
+            size_t hash = hashOf(oldSlots[i].first);
+            size_t index = findInsertSlot(hash);
+
+            new (&slots[index]) DataType(std::move(oldSlots[i]));
+            ctrl[index] = h2(hash);
+            oldSlots[i].~DataType();
+        }
+
+        deallocate(oldCtrl, oldSlots, oldCapacity);
+        deleted = 0;
+    }
+
+private:
+    static bool isFull(int8_t control) { return control >= 0; }
+
+    static size_t maxElementsFor(size_t capacity)
+    {
+        return capacity / FlatMapConstants::MAX_LOAD_DENOMINATOR * FlatMapConstants::MAX_LOAD_NUMERATOR;
+    }
+
+    // std::hash of an integer is the identity, so its bits are mixed before being split into H1 / H2
+    size_t hashOf(const Key& key) const { return static_cast<size_t>(Hashing::mix64(hasher(key))); }
+
+    static size_t h1(size_t hash) { return hash >> 7; }
+    static int8_t h2(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+    size_t groupCount() const { return cap / FlatMapConstants::GROUP_SIZE; }
+
+    // bit i of the result is set if ctrl[groupStart + i] == value
+    uint32_t matchByte(size_t groupStart, int8_t value) const
+    {
+#ifdef FLAT_MAP_SSE2
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl + groupStart));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < FlatMapConstants::GROUP_SIZE; ++i)
+            if (ctrl[groupStart + i] == value)
+                mask |= 1u << i;
+        return mask;
+#endif
+    }
+
+    uint32_t matchEmpty(size_t groupStart) const
+    {
+        return matchByte(groupStart, FlatMapConstants::EMPTY);
+    }
+
+    // empty and deleted are the only negative control bytes, so the sign bits are exactly them
+    uint32_t matchEmptyOrDeleted(size_t groupStart) const
+    {
+#ifdef FLAT_MAP_SSE2
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl + groupStart));
+        return static_cast<uint32_t>(_mm_movemask_epi8(group));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < FlatMapConstants::GROUP_SIZE; ++i)
+            if (!isFull(ctrl[groupStart + i]))
+                mask |= 1u << i;
+        return mask;
+#endif
+    }
+
+    static unsigned lowestBit(uint32_t mask)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+        unsigned bit = 0;
+        while (!(mask & 1u)) {
+            mask >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // probes whole groups in triangular order (g, g+1, g+3, g+6, ...),
+    // which visits every group exactly once when the group count is a power of two
+    size_t findIndex(const Key& key, size_t hash) const
+    {
+        if (sz == 0)
+            return cap;
+
+        size_t groupMask = groupCount() - 1;
+        size_t group = h1(hash) & groupMask;
+        int8_t fragment = h2(hash);
+
+        for (size_t step = 1; step <= groupCount(); ++step) {
+            size_t groupStart = group * FlatMapConstants::GROUP_SIZE;
+
+            for (uint32_t candidates = matchByte(groupStart, fragment); candidates != 0; candidates &= candidates - 1) {
+                size_t index = groupStart + lowestBit(candidates);
+                if (slots[index].first == key)
+                    return index;
+            }
+
+            if (matchEmpty(groupStart) != 0)
+                return cap;
+
+            group = (group + step) & groupMask;
+        }
+
+        return cap;
+    }
+
+    // first empty or deleted slot on the probe sequence; there always is one because of the load factor
+    size_t findInsertSlot(size_t hash) const
+    {
+        size_t groupMask = groupCount() - 1;
+        size_t group = h1(hash) & groupMask;
+
+        for (size_t step = 1;; ++step) {
+            size_t groupStart = group * FlatMapConstants::GROUP_SIZE;
+
+            uint32_t free = matchEmptyOrDeleted(groupStart);
+            if (free != 0)
+                return groupStart + lowestBit(free);
+
+            group = (group + step) & groupMask;
+        }
+    }
+
+    // if tombstones take most of the room, cleaning them up in place is enough
+    void rehashForInsert()
+    {
+        if (cap == 0)
+            resize(FlatMapConstants::INIT_CAPACITY);
+        else if (deleted > sz / 2)
+            resize(cap);
+        else
+            resize(cap * 2);
+    }
+
+    void allocate(size_t capacity)
+    {
+        ctrl = static_cast<int8_t*>(::operator new(capacity, std::align_val_t(FlatMapConstants::GROUP_SIZE)));
+        std::memset(ctrl, static_cast<unsigned char>(FlatMapConstants::EMPTY), capacity);
+
+        try {
+            slots = static_cast<DataType*>(::operator new(capacity * sizeof(DataType), std::align_val_t(alignof(DataType))));
+        } catch (...) {
+            ::operator delete(ctrl, std::align_val_t(FlatMapConstants::GROUP_SIZE));
+            throw;
+        }
+
+        cap = capacity;
+    }
+
+    static void deallocate(int8_t* oldCtrl, DataType* oldSlots, size_t oldCapacity)
+    {
+        if (oldCapacity == 0)
+            return;
+
+        ::operator delete(oldCtrl, std::align_val_t(FlatMapConstants::GROUP_SIZE));
+        ::operator delete(oldSlots, std::align_val_t(alignof(DataType)));
+    }
+
+    void destroyAll()
+    {
+        for (size_t i = 0; i < cap; ++i)
+            if (isFull(ctrl[i]))
+                slots[i].~DataType();
+    }
+
+    void copy(const FlatUnorderedMap& other)
+    {
+        if (other.cap == 0)
+            return;
+
+        allocate(other.cap);
+
+        for (size_t i = 0; i < other.cap; ++i) {
+            if (isFull(other.ctrl[i]))
+                new (&slots[i]) DataType(other.slots[i]);
+            ctrl[i] = other.ctrl[i];
+        }
+
+        sz = other.sz;
+        deleted = other.deleted;
+    }
+
+    void move(FlatUnorderedMap&& other)
+    {
+        ctrl = other.ctrl;
+        slots = other.slots;
+        cap = other.cap;
+        sz = other.sz;
+        deleted = other.deleted;
+        hasher = std::move(other.hasher);
+
+        other.ctrl = nullptr;
+        other.slots = nullptr;
+        other.cap = other.sz = other.deleted = 0;
+    }
+
+    void free()
+    {
+        destroyAll();
+        deallocate(ctrl, slots, cap);
+
+        ctrl = nullptr;
+        slots = nullptr;
+        cap = sz = deleted = 0;
+    }
+
+    int8_t* ctrl = nullptr;
+    DataType* slots = nullptr;
+    size_t cap = 0;
+    size_t sz = 0;
+    size_t deleted = 0;
+
+    Hasher hasher;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "HashFunctions.h"
+
+namespace FrequencySketchConstants {
+constexpr size_t DEPTH = 4; // counters per key
+constexpr size_t COUNTER_BITS = 4;
+constexpr size_t COUNTERS_PER_WORD = 64 / COUNTER_BITS;
+constexpr uint64_t MAX_COUNT = 15;
+// the counters are halved after SAMPLE_FACTOR * capacity increments
+constexpr size_t SAMPLE_FACTOR = 10;
+constexpr size_t MIN_CAPACITY = 16;
+constexpr uint64_t ONE_BITS = 0x1111111111111111ULL; // the lowest bit of every counter
+constexpr uint64_t HALVING_MASK = 0x7777777777777777ULL; // what is left of every counter after >> 1
+};
+
+// Count-Min sketch of 4 bit counters, 16 to a word: every key bumps DEPTH counters
+// and its frequency is the smallest of them, so it can only be overestimated (by collisions).
+// Every SAMPLE_FACTOR * capacity increments all counters are halved, so old popularity fades
+// and the counts stay a recent frequency rather than an all time one.
+// Takes the container's Hasher, so a key hashes the same way in both (see also the ByHash variants).
+template <typename Key, typename Hasher = std::hash<Key>>
+class FrequencySketch {
+public:
+    // expectedKeys is about how many distinct keys should be told apart, e.g. a cache's entry count
+    explicit FrequencySketch(size_t expectedKeys = FrequencySketchConstants::MIN_CAPACITY)
+        : table(Hashing::roundUpToPowerOfTwo(std::max(expectedKeys, FrequencySketchConstants::MIN_CAPACITY)), 0)
+        , sampleSize(FrequencySketchConstants::SAMPLE_FACTOR * table.size())
+    {
+    }
+
+    // O(const)
+    void increment(const Key& key) { incrementByHash(hasher(key)); }
+
+    // the hash must come from hashOf(key) (or the same hasher)
+    void incrementByHash(size_t hash)
+    {
+        uint64_t mixed = Hashing::mix64(hash);
+        bool changed = false;
+
+        for (size_t row = 0; row < FrequencySketchConstants::DEPTH; ++row) {
+            size_t counter = counterIndex(mixed, row);
+            uint64_t& word = table[counter / FrequencySketchConstants::COUNTERS_PER_WORD];
+            size_t shift = (counter % FrequencySketchConstants::COUNTERS_PER_WORD) * FrequencySketchConstants::COUNTER_BITS;
+
+            // saturates instead of wrapping
+            if (((word >> shift) & FrequencySketchConstants::MAX_COUNT) != FrequencySketchConstants::MAX_COUNT) {
+                word += uint64_t(1) << shift;
+                changed = true;
+            }
+        }
+
+        if (changed && ++additions >= sampleSize)
+            age();
+    }
+
+    // O(const), in [0, 15]
+    unsigned frequency(const Key& key) const { return frequencyByHash(hasher(key)); }
+
+    unsigned frequencyByHash(size_t hash) const
+    {
+        uint64_t mixed = Hashing::mix64(hash);
+        uint64_t smallest = FrequencySketchConstants::MAX_COUNT;
+
+        for (size_t row = 0; row < FrequencySketchConstants::DEPTH; ++row) {
+            size_t counter = counterIndex(mixed, row);
+            uint64_t word = table[counter / FrequencySketchConstants::COUNTERS_PER_WORD];
+            size_t shift = (counter % FrequencySketchConstants::COUNTERS_PER_WORD) * FrequencySketchConstants::COUNTER_BITS;
+            smallest = std::min(smallest, (word >> shift) & FrequencySketchConstants::MAX_COUNT);
+        }
+
+        return static_cast<unsigned>(smallest);
+    }
+
+    size_t hashOf(const Key& key) const { return hasher(key); }
+
+    // O(m): halves every counter
+    void age()
+    {
+        size_t oddCounters = 0;
+
+        for (uint64_t& word : table) {
+            oddCounters += popcount(word & FrequencySketchConstants::ONE_BITS);
+            word = (word >> 1) & FrequencySketchConstants::HALVING_MASK;
+        }
+
+        // the halving truncated the odd counters, which is taken off the additions as well
+        additions = (additions - std::min(additions, oddCounters / FrequencySketchConstants::DEPTH)) / 2;
+    }
+
+    void clear()
+    {
+        std::fill(table.begin(), table.end(), 0);
+        additions = 0;
+    }
+
+    size_t memory_bytes() const { return table.size() * sizeof(uint64_t); }
+
+private:
+    size_t counterCount() const { return table.size() * FrequencySketchConstants::COUNTERS_PER_WORD; }
+
+    // double hashing: row i looks at low + i * high, which is as good as DEPTH independent hashes
+    // for a Count-Min sketch and costs one mix
+    size_t counterIndex(uint64_t mixed, size_t row) const
+    {
+        uint64_t low = mixed & 0xffffffffULL;
+        uint64_t high = (mixed >> 32) | 1;
+        return static_cast<size_t>((low + row * high) & (counterCount() - 1));
+    }
+
+    static size_t popcount(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_popcountll(word));
+#else
+        size_t count = 0;
+        for (; word; word &= word - 1)
+            ++count;
+        return count;
+#endif
+    }
+
+    std::vector<uint64_t> table;
+    size_t sampleSize;
+    size_t additions = 0;
+
+    Hasher hasher;
+};
+
+// Admission policies for caches: record(key, hash) every access (hit, miss or put), and when a new key
+// would push out an entry, admit(candidate, candidateHash, victim, victimHash) says whether it may.
+// The hashes come from the cache's Hasher, which the cache has computed anyway - the policy never hashes.
+
+// admits everything - plain LRU
+template <typename Key, typename Hasher = std::hash<Key>>
+struct AlwaysAdmit {
+    explicit AlwaysAdmit(size_t) { }
+
+    void record(const Key&, size_t) { }
+    bool admit(const Key&, size_t, const Key&, size_t) const { return true; }
+};
+
+// TinyLFU: a new key only pushes out the victim if it has been seen more often recently.
+// A key seen once (a scan, a one hit wonder) loses to any entry that was used twice,
+// so it can no longer flush the hot entries out of the cache.
+template <typename Key, typename Hasher = std::hash<Key>>
+class TinyLFUAdmission {
+public:
+    explicit TinyLFUAdmission(size_t expectedEntries)
+        : sketch(expectedEntries)
+    {
+    }
+
+    void record(const Key&, size_t hash) { sketch.incrementByHash(hash); }
+
+    bool admit(const Key&, size_t candidateHash, const Key&, size_t victimHash) const
+    {
+        return sketch.frequencyByHash(candidateHash) > sketch.frequencyByHash(victimHash);
+    }
+
+    const FrequencySketch<Key, Hasher>& frequency_sketch() const { return sketch; }
+
+private:
+    FrequencySketch<Key, Hasher> sketch;
+};
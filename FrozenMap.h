@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HashFunctions.h"
+#include "UnorderedMapInsertionOrder.h"
+
+namespace FrozenMapConstants {
+constexpr char MAGIC[8] = { 'F', 'R', 'O', 'Z', 'E', 'N', 'M', 'P' };
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304; // reads differently on a machine of the other endianness
+constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+constexpr size_t SECTION_ALIGNMENT = 64;
+// the slot table is at most half full, so misses end after a couple of probes
+constexpr size_t SLOTS_PER_ENTRY = 2;
+};
+
+// How keys and values sit in a frozen file: trivially copyable types are stored as they are,
+// strings as an (offset, length) reference into one shared character blob.
+// Hashes come from Hashing::hashBytes and not from std::hash, so they are the same in every build.
+template <typename T, typename Enable = void>
+struct FrozenCodec {
+    static_assert(std::is_trivially_copyable_v<T>, "FrozenMap stores trivially copyable types and std::string only");
+
+    typedef T Stored;
+    typedef const T& View;
+    typedef const T& Lookup;
+
+    static Stored store(const T& value, std::string&) { return value; }
+    static View view(const Stored& stored, const char*) { return stored; }
+
+    // keys are hashed and compared by their bytes, so they must not contain padding
+    static uint64_t hash(Lookup key)
+    {
+        static_assert(std::has_unique_object_representations_v<T>, "Frozen keys must be compared by their bytes");
+        return Hashing::hashBytes(&key, sizeof(T));
+    }
+
+    static bool equals(const Stored& stored, const char*, Lookup key)
+    {
+        return std::memcmp(&stored, &key, sizeof(T)) == 0;
+    }
+};
+
+template <>
+struct FrozenCodec<std::string> {
+    struct Stored {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    typedef std::string_view View;
+    typedef std::string_view Lookup;
+
+    static Stored store(const std::string& value, std::string& blob)
+    {
+        Stored stored { blob.size(), value.size() };
+        blob += value;
+        return stored;
+    }
+
+    static View view(const Stored& stored, const char* blob) { return View(blob + stored.offset, stored.length); }
+
+    static uint64_t hash(Lookup key) { return Hashing::hashBytes(key.data(), key.size()); }
+
+    static bool equals(const Stored& stored, const char* blob, Lookup key) { return view(stored, blob) == key; }
+};
+
+// File layout - every offset is from the start of the file, so the mapping works at any address:
+// header | entries in insertion order | uint32_t slot table (open addressing, linear probing) | string blob
+struct FrozenHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    // layout of the writer's FrozenEntry, catches opening the file with other Key / Value types
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t entrySize;
+    uint64_t count;
+    uint64_t slotCount; // power of two
+    uint64_t entriesOffset;
+    uint64_t slotsOffset;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+    uint64_t fileSize;
+};
+
+template <typename Key, typename Value>
+struct FrozenEntry {
+    uint64_t hash;
+    typename FrozenCodec<Key>::Stored key;
+    typename FrozenCodec<Value>::Stored value;
+};
+
+namespace FrozenMapDetail {
+inline uint64_t alignUp(uint64_t offset)
+{
+    return (offset + FrozenMapConstants::SECTION_ALIGNMENT - 1) / FrozenMapConstants::SECTION_ALIGNMENT * FrozenMapConstants::SECTION_ALIGNMENT;
+}
+
+inline void writeAt(std::ofstream& out, uint64_t offset, const void* data, size_t size)
+{
+    static const char zeros[FrozenMapConstants::SECTION_ALIGNMENT] = {};
+
+    uint64_t position = static_cast<uint64_t>(out.tellp());
+    while (position < offset) {
+        size_t padding = static_cast<size_t>(std::min<uint64_t>(offset - position, sizeof(zeros)));
+        out.write(zeros, padding);
+        position += padding;
+    }
+
+    out.write(static_cast<const char*>(data), size);
+}
+};
+
+// Writes map to path as a FrozenMap file, keeping the insertion order.
+// The file is written next to path and renamed over it, so a process that has the old file mapped keeps a valid view.
+// The file is only readable on machines with the same endianness and the same struct layout.
+template <typename Key, typename Value, typename Hasher, typename Reduction>
+void freeze(const UnorderedMapInsertionOrder<Key, Value, Hasher, Reduction>& map, const std::string& path)
+{
+    typedef FrozenEntry<Key, Value> Entry;
+    static_assert(alignof(Entry) <= FrozenMapConstants::SECTION_ALIGNMENT, "Over-aligned keys or values");
+
+    if (map.size() >= FrozenMapConstants::EMPTY_SLOT)
+        throw std::length_error("Too many elements for a 32 bit slot table");
+
+    std::vector<Entry> entries;
+    entries.reserve(map.size());
+    std::string blob;
+
+    for (auto iter = map.cbegin(); iter != map.cend(); ++iter) {
+        Entry entry {}; // zeroes the padding too, so the file does not depend on stack garbage
+        entry.hash = FrozenCodec<Key>::hash(iter->first);
+        entry.key = FrozenCodec<Key>::store(iter->first, blob);
+        entry.value = FrozenCodec<Value>::store(iter->second, blob);
+        entries.push_back(entry);
+    }
+
+    size_t slotCount = Hashing::roundUpToPowerOfTwo(std::max<size_t>(1, entries.size() * FrozenMapConstants::SLOTS_PER_ENTRY));
+    std::vector<uint32_t> slots(slotCount, FrozenMapConstants::EMPTY_SLOT);
+
+    for (size_t position = 0; position < entries.size(); ++position) {
+        size_t slot = entries[position].hash & (slotCount - 1);
+        while (slots[slot] != FrozenMapConstants::EMPTY_SLOT)
+            slot = (slot + 1) & (slotCount - 1);
+
+        slots[slot] = static_cast<uint32_t>(position);
+    }
+
+    FrozenHeader header {};
+    std::memcpy(header.magic, FrozenMapConstants::MAGIC, sizeof(header.magic));
+    header.version = FrozenMapConstants::FORMAT_VERSION;
+    header.byteOrderMark = FrozenMapConstants::BYTE_ORDER_MARK;
+    header.keySize = sizeof(typename FrozenCodec<Key>::Stored);
+    header.valueSize = sizeof(typename FrozenCodec<Value>::Stored);
+    header.entrySize = sizeof(Entry);
+    header.count = entries.size();
+    header.slotCount = slotCount;
+    header.entriesOffset = FrozenMapDetail::alignUp(sizeof(FrozenHeader));
+    header.slotsOffset = FrozenMapDetail::alignUp(header.entriesOffset + entries.size() * sizeof(Entry));
+    header.blobOffset = FrozenMapDetail::alignUp(header.slotsOffset + slotCount * sizeof(uint32_t));
+    header.blobSize = blob.size();
+    header.fileSize = header.blobOffset + blob.size();
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Cannot open " + temporaryPath);
+
+        FrozenMapDetail::writeAt(out, 0, &header, sizeof(header));
+        FrozenMapDetail::writeAt(out, header.entriesOffset, entries.data(), entries.size() * sizeof(Entry));
+        FrozenMapDetail::writeAt(out, header.slotsOffset, slots.data(), slots.size() * sizeof(uint32_t));
+        FrozenMapDetail::writeAt(out, header.blobOffset, blob.data(), blob.size());
+
+        out.flush();
+        if (!out)
+            throw std::runtime_error("Cannot write " + temporaryPath);
+    }
+
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Cannot replace " + path);
+}
+
+// Read-only view of a file written by freeze(). Opening only maps the file - nothing is parsed or copied,
+// pages are read in on first touch. get / contains / iteration work directly on the mapping,
+// so keys and values come back as references (std::string_view for strings) into it,
+// valid as long as the FrozenMap lives. The file content itself is trusted.
+template <typename Key, typename Value>
+class FrozenMap {
+    typedef FrozenEntry<Key, Value> Entry;
+    typedef FrozenCodec<Key> KeyCodec;
+    typedef FrozenCodec<Value> ValueCodec;
+
+public:
+    typedef typename KeyCodec::View KeyView;
+    typedef typename ValueCodec::View ValueView;
+    typedef typename KeyCodec::Lookup KeyLookup;
+
+    explicit FrozenMap(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(FrozenHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Not a frozen map: " + path);
+        }
+
+        mappedSize = static_cast<size_t>(status.st_size);
+        void* mapping = ::mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error("Cannot map " + path);
+
+        base = static_cast<const char*>(mapping);
+
+        try {
+            validate();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+
+        header = reinterpret_cast<const FrozenHeader*>(base);
+        entries = reinterpret_cast<const Entry*>(base + header->entriesOffset);
+        slots = reinterpret_cast<const uint32_t*>(base + header->slotsOffset);
+        blob = base + header->blobOffset;
+    }
+
+    FrozenMap(const FrozenMap&) = delete;
+    FrozenMap& operator=(const FrozenMap&) = delete;
+
+    FrozenMap(FrozenMap&& other) noexcept { move(std::move(other)); }
+
+    FrozenMap& operator=(FrozenMap&& other) noexcept
+    {
+        if (this != &other) {
+            unmap();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~FrozenMap() { unmap(); }
+
+    size_t size() const { return header ? static_cast<size_t>(header->count) : 0; }
+    bool empty() const { return size() == 0; }
+
+    // O(const)
+    bool contains(KeyLookup key) const { return findEntry(key) != nullptr; }
+
+    // O(const)
+    ValueView get(KeyLookup key) const
+    {
+        const Entry* entry = findEntry(key);
+        if (!entry)
+            throw std::runtime_error("Element not found");
+
+        return ValueCodec::view(entry->value, blob);
+    }
+
+    class ConstIterator;
+
+    // elements in insertion order
+    ConstIterator cbegin() const { return ConstIterator(this, 0); }
+    ConstIterator cend() const { return ConstIterator(this, size()); }
+    ConstIterator begin() const { return cbegin(); }
+    ConstIterator end() const { return cend(); }
+
+    class ConstIterator {
+    public:
+        ConstIterator& operator++()
+        {
+            ++position;
+            return *this;
+        }
+
+        ConstIterator operator++(int)
+        {
+            return ConstIterator(map, position++);
+        }
+
+        // built on the fly from the mapping, so it is returned by value
+        std::pair<KeyView, ValueView> operator*() const
+        {
+            const Entry& entry = map->entries[position];
+            return std::pair<KeyView, ValueView>(KeyCodec::view(entry.key, map->blob), ValueCodec::view(entry.value, map->blob));
+        }
+
+        bool operator==(const ConstIterator& rhs) const { return position == rhs.position; }
+        bool operator!=(const ConstIterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class FrozenMap;
+
+        ConstIterator(const FrozenMap* map, size_t position)
+            : map(map)
+            , position(position)
+        {
+        }
+
+        const FrozenMap* map;
+        size_t position;
+    };
+
+private:
+    const Entry* findEntry(KeyLookup key) const
+    {
+        if (!header)
+            return nullptr;
+
+        uint64_t hash = KeyCodec::hash(key);
+        uint64_t mask = header->slotCount - 1;
+
+        // the table is at most half full, so there is always an empty slot to stop at
+        for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint32_t position = slots[slot];
+
+            if (position == FrozenMapConstants::EMPTY_SLOT)
+                return nullptr;
+
+            const Entry& entry = entries[position];
+            if (entry.hash == hash && KeyCodec::equals(entry.key, blob, key))
+                return &entry;
+        }
+    }
+
+    // the structure of the file must be sound, the entries themselves are not checked
+    void validate() const
+    {
+        const FrozenHeader* candidate = reinterpret_cast<const FrozenHeader*>(base);
+
+        bool valid = std::memcmp(candidate->magic, FrozenMapConstants::MAGIC, sizeof(candidate->magic)) == 0
+            && candidate->version == FrozenMapConstants::FORMAT_VERSION
+            && candidate->byteOrderMark == FrozenMapConstants::BYTE_ORDER_MARK
+            && candidate->keySize == sizeof(typename KeyCodec::Stored)
+            && candidate->valueSize == sizeof(typename ValueCodec::Stored)
+            && candidate->entrySize == sizeof(Entry)
+            && candidate->fileSize == mappedSize
+            && candidate->slotCount > candidate->count
+            && (candidate->slotCount & (candidate->slotCount - 1)) == 0
+            && candidate->entriesOffset % FrozenMapConstants::SECTION_ALIGNMENT == 0
+            && candidate->slotsOffset % FrozenMapConstants::SECTION_ALIGNMENT == 0
+            && candidate->entriesOffset + candidate->count * sizeof(Entry) <= candidate->slotsOffset
+            && candidate->slotsOffset + candidate->slotCount * sizeof(uint32_t) <= candidate->blobOffset
+            && candidate->blobOffset + candidate->blobSize <= mappedSize;
+
+        if (!valid)
+            throw std::runtime_error("Not a frozen map of these key and value types");
+    }
+
+    void move(FrozenMap&& other)
+    {
+        base = other.base;
+        mappedSize = other.mappedSize;
+        header = other.header;
+        entries = other.entries;
+        slots = other.slots;
+        blob = other.blob;
+
+        other.base = nullptr;
+        other.mappedSize = 0;
+        other.header = nullptr;
+    }
+
+    void unmap()
+    {
+        if (base)
+            ::munmap(const_cast<char*>(base), mappedSize);
+
+        base = nullptr;
+        header = nullptr;
+    }
+
+    const char* base = nullptr;
+    size_t mappedSize = 0;
+
+    const FrozenHeader* header = nullptr;
+    const Entry* entries = nullptr;
+    const uint32_t* slots = nullptr;
+    const char* blob = nullptr;
+};
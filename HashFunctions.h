@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace Hashing {
+// odd 64 bit constants with well spread bits (the ones wyhash uses)
+constexpr uint64_t SECRET0 = 0xa0761d6478bd642fULL;
+constexpr uint64_t SECRET1 = 0xe7037ed1a0b428dbULL;
+constexpr uint64_t SECRET2 = 0x8ebc6af09c88c6e3ULL;
+constexpr uint64_t SECRET3 = 0x589965cc75374cc3ULL;
+
+// 2^64 / golden ratio
+constexpr uint64_t FIBONACCI_MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+
+// Finalizer for integer keys (murmur3 fmix64): every input bit flips every output bit with ~50% chance.
+// It is a bijection, so distinct 64 bit keys never collide.
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// full 64x64 -> 128 bit product, folded back to 64 bits
+inline uint64_t multiplyFold(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    uint64_t aHigh = a >> 32, aLow = static_cast<uint32_t>(a);
+    uint64_t bHigh = b >> 32, bLow = static_cast<uint32_t>(b);
+    uint64_t lowLow = aLow * bLow, lowHigh = aLow * bHigh, highLow = aHigh * bLow, highHigh = aHigh * bHigh;
+
+    uint64_t middle = (lowLow >> 32) + static_cast<uint32_t>(lowHigh) + static_cast<uint32_t>(highLow);
+    uint64_t low = (middle << 32) | static_cast<uint32_t>(lowLow);
+    uint64_t high = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+    return low ^ high;
+#endif
+}
+
+// the input is always read as little endian, so a hash is the same on every platform
+// (hashes end up in files - see FrozenMap)
+inline uint64_t read64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+inline uint64_t read32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+// wyhash style hash of a byte string: 48 bytes per round in three independent lanes,
+// each folding 16 bytes with one wide multiply; short inputs take a single multiply
+inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= multiplyFold(seed ^ SECRET0, SECRET1);
+
+    uint64_t a, b;
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + middle);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t remaining = length;
+
+        if (remaining > 48) {
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = multiplyFold(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+                lane1 = multiplyFold(read64(p + 16) ^ SECRET2, read64(p + 24) ^ lane1);
+                lane2 = multiplyFold(read64(p + 32) ^ SECRET3, read64(p + 40) ^ lane2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+
+        while (remaining > 16) {
+            seed = multiplyFold(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        // the last 16 bytes, overlapping the previous round if needed
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    return multiplyFold(SECRET1 ^ length, multiplyFold(a ^ SECRET1, b ^ seed));
+}
+
+inline unsigned log2OfPowerOfTwo(size_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#else
+    unsigned result = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+constexpr size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+};
+
+// Drop-in replacement for std::hash with well mixed bits:
+// integers go through mix64 (std::hash of an integer is the identity), strings through hashBytes.
+// Transparent, so std::string keys can be looked up by std::string_view / const char*.
+struct FastHash {
+    typedef void is_transparent;
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, int> = 0>
+    size_t operator()(T key) const { return static_cast<size_t>(Hashing::mix64(static_cast<uint64_t>(key))); }
+
+    template <typename T>
+    size_t operator()(T* key) const { return static_cast<size_t>(Hashing::mix64(reinterpret_cast<uintptr_t>(key))); }
+
+    size_t operator()(std::string_view key) const { return static_cast<size_t>(Hashing::hashBytes(key.data(), key.size())); }
+    size_t operator()(const std::string& key) const { return operator()(std::string_view(key)); }
+    size_t operator()(const char* key) const { return operator()(std::string_view(key)); }
+
+    // anything else: its std::hash, mixed
+    template <typename T, std::enable_if_t<!std::is_integral_v<T> && !std::is_enum_v<T>, int> = 0>
+    size_t operator()(const T& key) const { return static_cast<size_t>(Hashing::mix64(std::hash<T>()(key))); }
+};
+
+// How the hash containers turn a hash into a bucket index (their Reduction template parameter).
+// bucketCount(requested) is the number of buckets a container really allocates when it asks for requested,
+// index(hash, bucketCount) maps a hash into [0, bucketCount).
+
+// any bucket count; one integer division per operation (20-40 cycles on x86-64)
+struct ModuloReduction {
+    static size_t bucketCount(size_t requested) { return requested; }
+    static size_t index(size_t hash, size_t bucketCount) { return hash % bucketCount; }
+};
+
+// power of two bucket counts, keeps the low bits of the hash - a single AND,
+// but only as good as the low bits, so pair it with a mixing hasher (FastHash) rather than std::hash
+struct MaskReduction {
+    static size_t bucketCount(size_t requested) { return requested > 0 ? Hashing::roundUpToPowerOfTwo(requested) : 0; }
+    static size_t index(size_t hash, size_t bucketCount) { return hash & (bucketCount - 1); }
+};
+
+// power of two bucket counts, multiplies by 2^64 / golden ratio and keeps the high bits:
+// one multiply and a shift, and it spreads even an identity hash of strided keys over all buckets
+struct FibonacciReduction {
+    static size_t bucketCount(size_t requested) { return requested > 0 ? Hashing::roundUpToPowerOfTwo(requested) : 0; }
+    static size_t index(size_t hash, size_t bucketCount)
+    {
+        uint64_t scrambled = static_cast<uint64_t>(hash) * Hashing::FIBONACCI_MULTIPLIER;
+        // two shifts, so that a single bucket (shift by 64) is not undefined
+        return static_cast<size_t>(scrambled >> (63 - Hashing::log2OfPowerOfTwo(bucketCount)) >> 1);
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "NaiveHashSet.h"
+#include "Parallel.h"
+#include "UnorderedSet.h"
+
+namespace HashSetAlgebraConstants {
+// below this many buckets to scan the threads cost more than they save
+constexpr size_t PARALLEL_THRESHOLD = 1 << 15;
+};
+
+// Bulk set algebra for NaiveHashSet and UnorderedSet (both operands of the same type, so one hash fits both).
+//
+// The expensive part - hashing every element and probing the other set - runs on threadCount threads
+// (0 = one per hardware thread), each owning a contiguous range of the scanned set's buckets,
+// which is a range of (reduced) hashes. Only the smaller operand is scanned wherever the result allows it.
+// The result is then sized once and filled on the calling thread with the hashes already computed,
+// so nothing is rehashed and nothing resizes midway; the filling stays on one thread
+// since the containers and their allocators (e.g. PoolAllocator) are not thread safe.
+// Results use a's allocator, so sets on an arena or pool get their results there too.
+
+namespace HashSetAlgebraDetail {
+enum class Keep {
+    IN_OTHER,
+    NOT_IN_OTHER,
+    ALL
+};
+
+template <typename T>
+struct Hashed {
+    const T* element; // points into the scanned set
+    size_t hash;
+    bool inOther;
+};
+
+template <typename T>
+using Selection = std::vector<std::vector<Hashed<T>>>; // one part per thread, in bucket order
+
+// hashes every element of source, probes other with it and keeps the ones asked for
+template <typename Set>
+Selection<typename Set::DataType> select(const Set& source, const Set& other, Keep keep, unsigned threadCount)
+{
+    typedef typename Set::DataType T;
+
+    threadCount = Parallel::resolveThreadCount(threadCount);
+    Selection<T> parts(threadCount);
+
+    Parallel::forChunks(source.bucket_count(), threadCount, HashSetAlgebraConstants::PARALLEL_THRESHOLD, [&](size_t begin, size_t end, unsigned thread) {
+        std::vector<Hashed<T>>& part = parts[thread];
+
+        source.for_each_in_buckets(begin, end, [&](const T& element) {
+            size_t hash = source.hashOf(element);
+            bool inOther = other.contains(element, hash);
+
+            if (keep == Keep::ALL || inOther == (keep == Keep::IN_OTHER))
+                part.push_back(Hashed<T> { &element, hash, inOther });
+        });
+    });
+
+    return parts;
+}
+
+template <typename T>
+size_t totalSize(const Selection<T>& parts)
+{
+    size_t total = 0;
+    for (const std::vector<Hashed<T>>& part : parts)
+        total += part.size();
+
+    return total;
+}
+
+// the selected elements are known to be missing from result
+template <typename Set>
+void insertAll(Set& result, const Selection<typename Set::DataType>& parts)
+{
+    for (const auto& part : parts)
+        for (const auto& selected : part)
+            result.insert(*selected.element, selected.hash);
+}
+};
+
+// a ∪ b: copies the larger set and adds what the smaller one has on top
+template <typename Set>
+Set unite(const Set& a, const Set& b, unsigned threadCount = 0)
+{
+    using namespace HashSetAlgebraDetail;
+
+    const Set& smaller = a.size() <= b.size() ? a : b;
+    const Set& larger = a.size() <= b.size() ? b : a;
+
+    auto missing = select(smaller, larger, Keep::NOT_IN_OTHER, threadCount);
+
+    Set result(larger);
+    result.reserve(larger.size() + totalSize(missing));
+    insertAll(result, missing);
+
+    return result;
+}
+
+// a ∩ b: scans the smaller set only
+template <typename Set>
+Set intersect(const Set& a, const Set& b, unsigned threadCount = 0)
+{
+    using namespace HashSetAlgebraDetail;
+
+    const Set& smaller = a.size() <= b.size() ? a : b;
+    const Set& larger = a.size() <= b.size() ? b : a;
+
+    auto common = select(smaller, larger, Keep::IN_OTHER, threadCount);
+
+    Set result(a.get_allocator());
+    result.reserve(totalSize(common));
+    insertAll(result, common);
+
+    return result;
+}
+
+// a \ b: scans b and removes its elements from a copy of a if b is the smaller one,
+// otherwise scans a for what b does not have
+template <typename Set>
+Set difference(const Set& a, const Set& b, unsigned threadCount = 0)
+{
+    using namespace HashSetAlgebraDetail;
+
+    if (b.size() < a.size()) {
+        auto common = select(b, a, Keep::IN_OTHER, threadCount);
+
+        Set result(a);
+        for (const auto& part : common)
+            for (const auto& selected : part)
+                result.remove(*selected.element, selected.hash);
+
+        return result;
+    }
+
+    auto onlyInA = select(a, b, Keep::NOT_IN_OTHER, threadCount);
+
+    Set result(a.get_allocator());
+    result.reserve(totalSize(onlyInA));
+    insertAll(result, onlyInA);
+
+    return result;
+}
+
+// a △ b: copies the larger set, then every element of the smaller one is removed if it is there and added if it is not
+template <typename Set>
+Set symmetric_difference(const Set& a, const Set& b, unsigned threadCount = 0)
+{
+    using namespace HashSetAlgebraDetail;
+
+    const Set& smaller = a.size() <= b.size() ? a : b;
+    const Set& larger = a.size() <= b.size() ? b : a;
+
+    auto scanned = select(smaller, larger, Keep::ALL, threadCount);
+
+    size_t added = 0;
+    for (const auto& part : scanned)
+        for (const auto& selected : part)
+            added += !selected.inOther;
+
+    Set result(larger);
+    result.reserve(larger.size() + added);
+
+    for (const auto& part : scanned) {
+        for (const auto& selected : part) {
+            if (selected.inOther)
+                result.remove(*selected.element, selected.hash);
+            else
+                result.insert(*selected.element, selected.hash);
+        }
+    }
+
+    return result;
+}
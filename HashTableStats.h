@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Health of a hash table: is it a bad hasher (long chains / probes at a normal load factor)
+// or a bad load factor (everything evenly long), and how much time goes into growing.
+//
+// Opt-in at compile time: with HASH_TABLE_STATS defined (-DHASH_TABLE_STATS, or before the first include)
+// every hash container gets a stats() snapshot and counts its resizes; without it they carry nothing extra.
+
+namespace HashTableStatsConstants {
+// the last entry of a histogram counts everything at least that long
+constexpr size_t HISTOGRAM_SIZE = 16;
+};
+
+struct HashTableStats {
+    const char* layout = "chaining"; // or "open addressing"
+    size_t size = 0;
+    size_t bucketCount = 0;
+    double loadFactor = 0.0; // size / bucketCount
+
+    // chaining: how many buckets hold a chain of length i (i = 0 are the empty buckets);
+    // open addressing: how many elements sit i slots away from their home slot
+    std::vector<size_t> lengthHistogram = std::vector<size_t>(HashTableStatsConstants::HISTOGRAM_SIZE, 0);
+    size_t maxLength = 0;
+    double averageLength = 0.0; // per non-empty chain, or per element for open addressing
+
+    size_t tombstones = 0; // deleted slots still taking part in probing
+    double tombstoneRatio = 0.0; // tombstones / bucketCount
+
+    size_t resizeCount = 0;
+    double resizeSeconds = 0.0;
+
+    std::string toJson() const
+    {
+        std::string json = "{\"layout\":\"" + std::string(layout) + "\""
+            + ",\"size\":" + std::to_string(size)
+            + ",\"bucketCount\":" + std::to_string(bucketCount)
+            + ",\"loadFactor\":" + number(loadFactor)
+            + ",\"lengthHistogram\":[";
+
+        for (size_t i = 0; i < lengthHistogram.size(); ++i)
+            json += (i > 0 ? "," : "") + std::to_string(lengthHistogram[i]);
+
+        return json + "]"
+            + ",\"maxLength\":" + std::to_string(maxLength)
+            + ",\"averageLength\":" + number(averageLength)
+            + ",\"tombstones\":" + std::to_string(tombstones)
+            + ",\"tombstoneRatio\":" + number(tombstoneRatio)
+            + ",\"resizeCount\":" + std::to_string(resizeCount)
+            + ",\"resizeSeconds\":" + number(resizeSeconds)
+            + "}";
+    }
+
+private:
+    static std::string number(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+};
+
+// kept inside the container, bumped by HashTableResizeTimer
+struct HashTableResizeCounter {
+    size_t count = 0;
+    std::chrono::steady_clock::duration time {};
+};
+
+// times one resize (or one step of an incremental one, which does not count as another resize)
+class HashTableResizeTimer {
+public:
+    explicit HashTableResizeTimer(HashTableResizeCounter& counter, bool newResize = true)
+        : counter(counter)
+        , start(std::chrono::steady_clock::now())
+    {
+        counter.count += newResize;
+    }
+
+    HashTableResizeTimer(const HashTableResizeTimer&) = delete;
+    HashTableResizeTimer& operator=(const HashTableResizeTimer&) = delete;
+
+    ~HashTableResizeTimer() { counter.time += std::chrono::steady_clock::now() - start; }
+
+private:
+    HashTableResizeCounter& counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+namespace HashTableStatsDetail {
+// the containers walk their buckets and report every chain (or every element's probe distance) here
+class Builder {
+public:
+    Builder(const char* layout, size_t size, size_t bucketCount)
+    {
+        stats.layout = layout;
+        stats.size = size;
+        stats.bucketCount = bucketCount;
+    }
+
+    // chaining: one bucket with a chain of this length
+    void chain(size_t length)
+    {
+        record(length);
+        samples += length > 0;
+    }
+
+    // open addressing: one element this far from its home slot
+    void probe(size_t distance)
+    {
+        record(distance);
+        ++samples;
+    }
+
+    void tombstones(size_t count) { stats.tombstones += count; }
+
+    HashTableStats build(const HashTableResizeCounter& resizes)
+    {
+        stats.loadFactor = stats.bucketCount > 0 ? static_cast<double>(stats.size) / stats.bucketCount : 0.0;
+        stats.averageLength = samples > 0 ? static_cast<double>(total) / samples : 0.0;
+        stats.tombstoneRatio = stats.bucketCount > 0 ? static_cast<double>(stats.tombstones) / stats.bucketCount : 0.0;
+        stats.resizeCount = resizes.count;
+        stats.resizeSeconds = std::chrono::duration<double>(resizes.time).count();
+
+        return stats;
+    }
+
+private:
+    void record(size_t length)
+    {
+        ++stats.lengthHistogram[std::min(length, HashTableStatsConstants::HISTOGRAM_SIZE - 1)];
+        stats.maxLength = std::max(stats.maxLength, length);
+        total += length;
+    }
+
+    HashTableStats stats;
+    size_t samples = 0;
+    size_t total = 0;
+};
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "DoublyLinkedList.h"
+#include "FrequencySketch.h"
+#include "HashFunctions.h"
+#include "UnorderedMap.h"
+
+namespace LRUCacheConstants {
+constexpr size_t DEFAULT_SHARD_COUNT = 16;
+constexpr size_t CACHE_LINE_SIZE = 64;
+};
+
+// how much of the byte capacity one entry takes
+template <typename Key, typename Value>
+struct LRUDefaultSizer {
+    size_t operator()(const Key&, const Value&) const { return sizeof(Key) + sizeof(Value); }
+};
+
+struct LRUCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t rejections = 0; // new keys the admission policy kept out
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Every shard is a DLL ordered by recency (front = most recent) plus an UnorderedMap
+// from key to the DLL node, so get/put/evict are all O(const).
+// A key is hashed once per call; the shard and the index lookup both use that hash.
+// Keys are spread over independently locked shards, so threads only contend
+// when they hit the same shard.
+// Admission decides whether a new key may evict the least recent entry (see FrequencySketch.h);
+// with TinyLFUAdmission<Key, Hasher> a scan of one off keys cannot flush the hot entries.
+template <typename Key, typename Value,
+    typename Hasher = std::hash<Key>,
+    typename Sizer = LRUDefaultSizer<Key, Value>,
+    typename Admission = AlwaysAdmit<Key, Hasher>>
+class LRUCache {
+    struct Entry {
+        Key key;
+        Value value;
+        size_t bytes;
+        size_t hash; // hasher(key), so evicting it does not hash again
+    };
+
+    typedef DLL<Entry> RecencyList;
+    typedef typename RecencyList::iterator RecencyIterator;
+
+    struct alignas(LRUCacheConstants::CACHE_LINE_SIZE) Shard {
+        std::mutex lock;
+        RecencyList recency;
+        UnorderedMap<Key, RecencyIterator, Hasher> index;
+        size_t bytes = 0;
+        size_t capacity = 0;
+        LRUCacheStats stats;
+        std::optional<Admission> admission; // one per shard, guarded by its lock
+    };
+
+public:
+    // Every shard gets capacityBytes / shardCount bytes, the first capacityBytes % shardCount of them one more,
+    // so the shards add up to exactly capacityBytes. A cache too small to give every shard room for one entry
+    // of the default size (sizeof(Key) + sizeof(Value)) gets fewer shards instead - see shard_count().
+    explicit LRUCache(size_t capacityBytes, size_t shardCount = LRUCacheConstants::DEFAULT_SHARD_COUNT)
+        : shardCount(effectiveShardCount(capacityBytes, shardCount))
+        , capacityBytes(capacityBytes)
+    {
+        shards.reset(new Shard[this->shardCount]);
+
+        for (size_t i = 0; i < this->shardCount; ++i) {
+            shards[i].capacity = capacityBytes / this->shardCount + (i < capacityBytes % this->shardCount);
+            // sized for about as many keys as the shard holds entries of the default size
+            shards[i].admission.emplace(shards[i].capacity / (sizeof(Key) + sizeof(Value)));
+        }
+    }
+
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+
+    // O(const), copies the value out since the entry may be evicted by another thread right after
+    bool get(const Key& key, Value& result)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        shard.admission->record(key, hash);
+
+        auto found = shard.index.find(key, hash);
+        if (found == shard.index.end()) {
+            ++shard.stats.misses;
+            return false;
+        }
+
+        RecencyIterator iter = found->second;
+        shard.recency.moveToFront(iter);
+        result = iter->value;
+        ++shard.stats.hits;
+        return true;
+    }
+
+    bool contains(const Key& key)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        return shard.index.contains(key, hash);
+    }
+
+    // O(const) amortized; inserts or overwrites, then evicts from the back until the shard fits.
+    // A new key that would evict is dropped instead if the admission policy prefers the victim;
+    // returns whether the key is in the cache afterwards
+    bool put(const Key& key, const Value& value)
+    {
+        size_t bytes = sizer(key, value);
+        size_t hash = hasher(key);
+
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        shard.admission->record(key, hash);
+
+        auto found = shard.index.find(key, hash);
+        if (found != shard.index.end()) {
+            RecencyIterator iter = found->second;
+            shard.bytes = shard.bytes - iter->bytes + bytes;
+            iter->value = value;
+            iter->bytes = bytes;
+            shard.recency.moveToFront(iter);
+        } else {
+            if (shard.bytes + bytes > shard.capacity && !shard.recency.empty()
+                && !shard.admission->admit(key, hash, shard.recency.rbegin()->key, shard.recency.rbegin()->hash)) {
+                ++shard.stats.rejections;
+                return false;
+            }
+
+            shard.recency.pushFront(Entry { key, value, bytes, hash });
+            shard.index.insert(key, shard.recency.begin(), hash);
+            shard.bytes += bytes;
+        }
+
+        // an entry bigger than the whole shard evicts itself as well
+        while (shard.bytes > shard.capacity && !shard.recency.empty())
+            evictLast(shard);
+
+        // key is at the front and evictions take the back, so it is gone only if the shard emptied out
+        return !shard.recency.empty();
+    }
+
+    bool remove(const Key& key)
+    {
+        size_t hash = hasher(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        RecencyIterator iter;
+        if (!shard.index.remove(key, hash, iter))
+            return false;
+
+        shard.bytes -= iter->bytes;
+        shard.recency.remove(iter);
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < shardCount; ++i) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            shards[i].recency.clear();
+            shards[i].index.clear();
+            shards[i].bytes = 0;
+        }
+    }
+
+    // the shards are read one at a time, so under concurrent writes this is not an atomic snapshot
+    LRUCacheStats stats() const
+    {
+        LRUCacheStats total;
+
+        for (size_t i = 0; i < shardCount; ++i) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            total.hits += shards[i].stats.hits;
+            total.misses += shards[i].stats.misses;
+            total.evictions += shards[i].stats.evictions;
+            total.rejections += shards[i].stats.rejections;
+            total.entries += shards[i].index.size();
+            total.bytes += shards[i].bytes;
+        }
+
+        return total;
+    }
+
+    size_t size() const { return stats().entries; }
+    size_t capacity() const { return capacityBytes; }
+    size_t shard_count() const { return shardCount; }
+
+private:
+    static size_t effectiveShardCount(size_t capacityBytes, size_t requested)
+    {
+        size_t entryBytes = sizeof(Key) + sizeof(Value);
+        size_t count = requested > 0 ? requested : 1;
+
+        if (capacityBytes / count < entryBytes)
+            count = std::max<size_t>(1, capacityBytes / entryBytes);
+
+        return count;
+    }
+
+    // hash = hasher(key)
+    Shard& shardFor(size_t hash) const
+    {
+        // the maps inside the shards use hash % buckets themselves,
+        // so the shard is picked from mixed bits to keep the two choices independent
+        return shards[Hashing::mix64(hash) % shardCount];
+    }
+
+    void evictLast(Shard& shard)
+    {
+        RecencyIterator last(shard.recency.rbegin());
+
+        shard.bytes -= last->bytes;
+        shard.index.remove(last->key, last->hash);
+        shard.recency.remove(last);
+        ++shard.stats.evictions;
+    }
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCount;
+    size_t capacityBytes;
+
+    Hasher hasher;
+    Sizer sizer;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace MonotonicArenaConstants {
+constexpr size_t INIT_CHUNK_SIZE = 4096;
+constexpr size_t GROWTH_FACTOR = 2;
+constexpr size_t MAX_CHUNK_SIZE = size_t(1) << 20;
+};
+
+// Bump allocator for build once, drop all data (e.g. per request maps):
+// allocation moves a pointer forward through big chunks, deallocation does not give anything back
+// (only counts), and once everything allocated from it has been deallocated, or on release(),
+// the arena starts over - all of its memory goes at once instead of node by node through the heap.
+// Memory freed in between is not reused, so it does not suit long lived data with a lot of churn (see PoolAllocator.h).
+// Not thread safe; it must outlive everything allocated from it.
+class MonotonicArena {
+public:
+    explicit MonotonicArena(size_t initialChunkSize = MonotonicArenaConstants::INIT_CHUNK_SIZE)
+        : nextChunkSize(std::max<size_t>(initialChunkSize, alignof(std::max_align_t)))
+    {
+    }
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    ~MonotonicArena() { freeChunks(chunks.size()); }
+
+    // amortized O(const)
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+            throw std::logic_error("Alignment must be a power of two");
+
+        uintptr_t start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+
+        if (chunks.empty() || start + bytes > chunkEnd) {
+            addChunk(bytes + alignment);
+            start = (cursor + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        }
+
+        cursor = start + bytes;
+        ++liveAllocations;
+        bytesAllocated += bytes;
+
+        return reinterpret_cast<void*>(start);
+    }
+
+    // O(const): nothing is freed until the last allocation is gone
+    void deallocate(void*, size_t)
+    {
+        if (liveAllocations > 0 && --liveAllocations == 0)
+            rewind();
+    }
+
+    // Drops everything at once, keeping only the newest (largest) chunk for reuse.
+    // Whatever was allocated from the arena must not be touched afterwards
+    void release()
+    {
+        liveAllocations = 0;
+        rewind();
+    }
+
+    // O(number of chunks): gives all memory back to the heap, same caveat as release()
+    void shrink()
+    {
+        freeChunks(chunks.size());
+        chunks.clear();
+        cursor = chunkEnd = 0;
+        liveAllocations = 0;
+        bytesAllocated = 0;
+    }
+
+    size_t live_allocations() const { return liveAllocations; }
+    size_t bytes_allocated() const { return bytesAllocated; }
+
+    size_t bytes_reserved() const
+    {
+        size_t total = 0;
+        for (const Chunk& chunk : chunks)
+            total += chunk.size;
+
+        return total;
+    }
+
+private:
+    struct Chunk {
+        void* memory;
+        size_t size;
+    };
+
+    void addChunk(size_t minimumSize)
+    {
+        size_t size = std::max(nextChunkSize, minimumSize);
+        chunks.push_back(Chunk { ::operator new(size), size });
+
+        cursor = reinterpret_cast<uintptr_t>(chunks.back().memory);
+        chunkEnd = cursor + size;
+        nextChunkSize = std::min(nextChunkSize * MonotonicArenaConstants::GROWTH_FACTOR,
+            std::max(MonotonicArenaConstants::MAX_CHUNK_SIZE, nextChunkSize));
+    }
+
+    // frees every chunk but the last one and starts over at its beginning
+    void rewind()
+    {
+        if (chunks.empty())
+            return;
+
+        freeChunks(chunks.size() - 1);
+        chunks.erase(chunks.begin(), chunks.end() - 1);
+
+        cursor = reinterpret_cast<uintptr_t>(chunks.back().memory);
+        chunkEnd = cursor + chunks.back().size;
+        bytesAllocated = 0;
+    }
+
+    void freeChunks(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            ::operator delete(chunks[i].memory);
+    }
+
+    std::vector<Chunk> chunks;
+    uintptr_t cursor = 0;
+    uintptr_t chunkEnd = 0;
+    size_t nextChunkSize;
+
+    size_t liveAllocations = 0;
+    size_t bytesAllocated = 0;
+};
+
+// std compatible allocator handing out memory from a MonotonicArena, e.g.
+//   MonotonicArena arena;
+//   UnorderedMap<int, int, std::hash<int>, ModuloReduction, ArenaAllocator<std::pair<int, int>>> map(arena);
+// All copies and rebinds share the arena, so containers built on it can splice between each other.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator(MonotonicArena& arena)
+        : arena(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* pointer, size_t count) { arena->deallocate(pointer, count * sizeof(T)); }
+
+    MonotonicArena& resource() const { return *arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& rhs) const { return arena == rhs.arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& rhs) const { return arena != rhs.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    MonotonicArena* arena;
+};
@@ -1,13 +1,43 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <list>
+#include <memory>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-template <typename T, typename Hasher = std::hash<T>>
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+#include "Prefetch.h"
+#include "TransparentHash.h"
+
+// Reduction picks how a hash becomes a bucket index (see HashFunctions.h)
+// Allocator is used for the chain nodes, e.g. PoolAllocator or ArenaAllocator
+template <typename T, typename Hasher = std::hash<T>, typename Reduction = ModuloReduction, typename Allocator = std::allocator<T>>
 class NaiveHashSet {
+    typedef std::list<T, Allocator> Chain;
+
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename K>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<K>, T>, int>;
+
 public:
+    typedef T DataType;
+
+    NaiveHashSet()
+        : NaiveHashSet(Allocator())
+    {
+    }
+
+    explicit NaiveHashSet(const Allocator& allocator)
+        : collisionBuckets(Reduction::bucketCount(INIT_CAPACITY), Chain(allocator))
+        , allocator(allocator)
+    {
+    }
+
     void clear()
     {
         collisionBuckets.clear();
@@ -18,50 +48,175 @@ public:
 
     bool empty() const { return sz == 0; }
 
-    bool insert(const T& element)
+    size_t bucket_count() const { return collisionBuckets.size(); }
+
+    Allocator get_allocator() const { return allocator; }
+
+    // fn(element) for every element, in no particular order
+    template <typename Function>
+    void for_each(Function&& fn) const { for_each_in_buckets(0, collisionBuckets.size(), fn); }
+
+    // fn(element) for the elements of buckets [first, last), so disjoint ranges can be read by different threads
+    template <typename Function>
+    void for_each_in_buckets(size_t first, size_t last, Function&& fn) const
     {
-        size_t index = getBucketIndex(element);
-        auto& chain = collisionBuckets[index];
+        for (size_t bucket = first; bucket < last; ++bucket)
+            for (const T& element : collisionBuckets[bucket])
+                fn(element);
+    }
 
-        for (auto iter = chain.begin(); iter != chain.end(); ++iter)
-            if (*iter == element)
-                return false;
+    // grows once so that elementCount elements fit without further resizes
+    void reserve(size_t elementCount) { reserveFor(elementCount); }
 
-        chain.push_back(element);
-        ++sz;
+#ifdef HASH_TABLE_STATS
+    // O(n)
+    HashTableStats stats() const
+    {
+        HashTableStatsDetail::Builder builder("chaining", sz, collisionBuckets.size());
 
-        if (size() == INIT_LOAD_FACTOR * collisionBuckets.capacity())
-            resize(collisionBuckets.capacity() * GROWTH_FACTOR);
+        for (const Chain& chain : collisionBuckets)
+            builder.chain(chain.size());
 
-        return true;
+        return builder.build(resizeCounter);
     }
+#endif
 
+    bool insert(const T& element) { return insertImpl(element, hash(element)); }
     bool insert(T&& element)
     {
-        size_t index = getBucketIndex(element);
-        auto& chain = collisionBuckets[index];
+        size_t elementHash = hash(element);
+        return insertImpl(std::move(element), elementHash);
+    }
+
+    // the hash must come from hashOf(element) (or the same hasher)
+    bool insert(const T& element, size_t elementHash) { return insertImpl(element, elementHash); }
+
+    bool contains(const T& element) const { return contains(element, hash(element)); }
+    bool contains(const T& element, size_t elementHash) const { return containsImpl(element, elementHash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& element) const { return containsImpl(element, hash(element)); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& element, size_t elementHash) const { return containsImpl(element, elementHash); }
+
+    size_t hashOf(const T& element) const { return hash(element); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    size_t hashOf(const K& element) const { return hash(element); }
+
+    bool remove(const T& element) { return removeImpl(element, hash(element)); }
+
+    // the hash must come from hashOf(element) (or the same hasher)
+    bool remove(const T& element, size_t elementHash) { return removeImpl(element, elementHash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool remove(const K& element) { return removeImpl(element, hash(element)); }
+
+    // Batched lookups for long probe streams (e.g. the probe side of a hash join):
+    // a batch is hashed first, then its buckets and first chain nodes are prefetched,
+    // and only then compared - the cache misses of a batch overlap instead of being paid one by one.
+    // out[i] = contains(keys[i])
+    void contains_many(const T* keys, size_t count, bool* out) const
+    {
+        size_t hashes[PrefetchConstants::BATCH_SIZE];
+
+        for (size_t start = 0; start < count; start += PrefetchConstants::BATCH_SIZE) {
+            size_t batch = std::min(count - start, PrefetchConstants::BATCH_SIZE);
+            prefetchBatch(keys + start, batch, hashes);
+
+            for (size_t i = 0; i < batch; ++i)
+                out[start + i] = containsImpl(keys[start + i], hashes[i]);
+        }
+    }
+
+    // same pipelining as contains_many; grows once up front instead of in the middle of a batch
+    // returns how many elements were new
+    size_t insert_many(const T* elements, size_t count)
+    {
+        reserveFor(sz + count);
+
+        size_t hashes[PrefetchConstants::BATCH_SIZE];
+        size_t inserted = 0;
+
+        for (size_t start = 0; start < count; start += PrefetchConstants::BATCH_SIZE) {
+            size_t batch = std::min(count - start, PrefetchConstants::BATCH_SIZE);
+            prefetchBatch(elements + start, batch, hashes);
+
+            for (size_t i = 0; i < batch; ++i)
+                inserted += insertImpl(elements[start + i], hashes[i]);
+        }
+
+        return inserted;
+    }
+
+private:
+    // hashes[i] = hash(keys[i]); prefetches the bucket headers, then the first node of every non-empty chain
+    void prefetchBatch(const T* keys, size_t batch, size_t* hashes) const
+    {
+        for (size_t i = 0; i < batch; ++i)
+            hashes[i] = hash(keys[i]);
+
+        if (collisionBuckets.empty())
+            return;
+
+        const Chain* chains[PrefetchConstants::BATCH_SIZE];
+
+        for (size_t i = 0; i < batch; ++i) {
+            chains[i] = &collisionBuckets[getBucketIndex(hashes[i])];
+            prefetchForRead(chains[i]);
+        }
+
+        for (size_t i = 0; i < batch; ++i)
+            if (!chains[i]->empty())
+                prefetchForRead(&chains[i]->front());
+    }
+
+    // enough buckets that elementCount elements fit without a resize
+    void reserveFor(size_t elementCount)
+    {
+        size_t newCapacity = collisionBuckets.empty() ? Reduction::bucketCount(INIT_CAPACITY) : collisionBuckets.size();
+
+        while (elementCount >= INIT_LOAD_FACTOR * newCapacity)
+            newCapacity *= GROWTH_FACTOR;
+
+        if (newCapacity != collisionBuckets.size())
+            resize(newCapacity);
+    }
+
+    size_t getBucketIndex(size_t elementHash) const
+    {
+        return Reduction::index(elementHash, collisionBuckets.size());
+    }
+
+    template <typename U>
+    bool insertImpl(U&& element, size_t elementHash)
+    {
+        if (collisionBuckets.empty())
+            collisionBuckets.resize(Reduction::bucketCount(INIT_CAPACITY), Chain(allocator));
+
+        auto& chain = collisionBuckets[getBucketIndex(elementHash)];
 
         for (auto iter = chain.begin(); iter != chain.end(); ++iter)
             if (*iter == element)
                 return false;
 
-        chain.push_back(std::move(element));
-
+        chain.push_back(std::forward<U>(element));
         ++sz;
 
-        if (size() == INIT_LOAD_FACTOR * collisionBuckets.capacity())
-            resize(collisionBuckets.capacity() * GROWTH_FACTOR);
+        if (size() >= INIT_LOAD_FACTOR * collisionBuckets.size())
+            resize(collisionBuckets.size() * GROWTH_FACTOR);
 
         return true;
     }
 
-    bool contains(const T& element) const
+    template <typename K>
+    bool containsImpl(const K& element, size_t elementHash) const
     {
         if (empty())
             return false;
 
-        size_t index = getBucketIndex(element);
-        auto& chain = collisionBuckets[index];
+        auto& chain = collisionBuckets[getBucketIndex(elementHash)];
 
         for (auto iter = chain.begin(); iter != chain.end(); ++iter)
             if (*iter == element)
@@ -70,13 +225,13 @@ public:
         return false;
     }
 
-    bool remove(const T& element)
+    template <typename K>
+    bool removeImpl(const K& element, size_t elementHash)
     {
         if (empty())
             return false;
 
-        size_t index = getBucketIndex(element);
-        auto& chain = collisionBuckets[index];
+        auto& chain = collisionBuckets[getBucketIndex(elementHash)];
 
         for (auto iter = chain.begin(); iter != chain.end(); ++iter) {
             if (*iter == element) {
@@ -89,29 +244,37 @@ public:
         return false;
     }
 
-private:
-    size_t getBucketIndex(const T& element) const
-    {
-        return hash(element) % collisionBuckets.size();
-    }
-
+    // the nodes are spliced into their new chains, so nothing is copied or allocated
     void resize(size_t newCapacity)
     {
-        std::vector<std::list<T>> oldDataBuckets = collisionBuckets;
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
+
+        std::vector<Chain> oldDataBuckets(std::move(collisionBuckets));
 
         collisionBuckets.clear();
-        collisionBuckets.reserve(newCapacity);
+        collisionBuckets.resize(Reduction::bucketCount(newCapacity), Chain(allocator));
 
-        for (auto bucket : oldDataBuckets)
-            for (auto element : bucket)
-                insert(element);
+        for (auto& bucket : oldDataBuckets) {
+            while (!bucket.empty()) {
+                auto& newChain = collisionBuckets[getBucketIndex(hash(bucket.front()))];
+                newChain.splice(newChain.end(), bucket, bucket.begin());
+            }
+        }
     }
 
-    const double INIT_LOAD_FACTOR = 0.7;
-    const size_t GROWTH_FACTOR = 2;
+    static constexpr double INIT_LOAD_FACTOR = 0.7;
+    static constexpr size_t INIT_CAPACITY = 16;
+    static constexpr size_t GROWTH_FACTOR = 2;
 
-    std::vector<std::list<T>> collisionBuckets;
+    std::vector<Chain> collisionBuckets;
     Hasher hash;
+    Allocator allocator; // every chain gets a copy, so splicing between them is allowed
 
     size_t sz = 0;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
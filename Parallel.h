@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Plain fork-join over index ranges for the bulk operations (perfect hash building, set algebra)
+namespace Parallel {
+// 0 means one thread per hardware thread
+inline unsigned resolveThreadCount(unsigned threadCount)
+{
+    if (threadCount > 0)
+        return threadCount;
+
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+// fn(begin, end, threadIndex) on threadCount contiguous chunks of [0, count);
+// below minimumCount everything runs on the calling thread, since the threads would cost more than they save
+template <typename Function>
+void forChunks(size_t count, unsigned threadCount, size_t minimumCount, Function&& fn)
+{
+    if (threadCount <= 1 || count < minimumCount) {
+        fn(size_t(0), count, 0u);
+        return;
+    }
+
+    size_t chunk = (count + threadCount - 1) / threadCount;
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < threadCount && t * chunk < count; ++t)
+        threads.emplace_back([&fn, t, chunk, count]() { fn(t * chunk, std::min(count, (t + 1) * chunk), t); });
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "HashFunctions.h"
+#include "Parallel.h"
+#include "UnorderedMap.h"
+#include "UnorderedSet.h"
+
+namespace PerfectHashConstants {
+// bits per key on every level; more bits means fewer collisions and levels, but a bigger function
+constexpr double GAMMA = 2.0;
+constexpr unsigned MAX_LEVELS = 32;
+constexpr size_t WORD_BITS = 64;
+constexpr size_t WORDS_PER_RANK_BLOCK = 8; // one cumulative count per 512 bits
+constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+// below this many keys the threads cost more than they save
+constexpr size_t PARALLEL_THRESHOLD = 1 << 16;
+};
+
+namespace PerfectHashDetail {
+inline unsigned popcount(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+    unsigned count = 0;
+    for (; word; word &= word - 1)
+        ++count;
+    return count;
+#endif
+}
+};
+
+// BBHash style minimal perfect hash over 64 bit key hashes.
+// Level i is a bit array of GAMMA * (keys left) bits: every key sets the bit at its level-i position,
+// the keys that landed on an already taken bit clear it and move on to level i + 1.
+// A key's index is the number of set bits before its bit (rank), so n keys get exactly [0, n).
+// Lookup walks the levels until it finds its bit set - ~1.6 levels on average, and the function
+// is ~3.7 bits per key including the rank samples.
+// Keys still colliding after MAX_LEVELS (in practice only keys with equal 64 bit hashes) are handed back to the caller.
+class MinimalPerfectHash {
+    struct Level {
+        size_t bitOffset; // into the concatenated bits of all levels
+        size_t size;
+    };
+
+public:
+    // returns the hashes that could not be placed
+    std::vector<uint64_t> build(std::vector<uint64_t> hashes, unsigned threadCount)
+    {
+        levels.clear();
+        bits.clear();
+
+        for (unsigned level = 0; level < PerfectHashConstants::MAX_LEVELS && !hashes.empty(); ++level) {
+            size_t size = roundToWords(static_cast<size_t>(PerfectHashConstants::GAMMA * hashes.size()));
+            size_t words = size / PerfectHashConstants::WORD_BITS;
+
+            std::vector<std::atomic<uint64_t>> taken(words);
+            std::vector<std::atomic<uint64_t>> collided(words);
+            for (size_t w = 0; w < words; ++w) {
+                taken[w].store(0, std::memory_order_relaxed);
+                collided[w].store(0, std::memory_order_relaxed);
+            }
+
+            Parallel::forChunks(hashes.size(), threadCount, PerfectHashConstants::PARALLEL_THRESHOLD, [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; ++i) {
+                    size_t position = positionOf(hashes[i], level, size);
+                    uint64_t mask = uint64_t(1) << (position % PerfectHashConstants::WORD_BITS);
+
+                    uint64_t before = taken[position / PerfectHashConstants::WORD_BITS].fetch_or(mask, std::memory_order_relaxed);
+                    if (before & mask)
+                        collided[position / PerfectHashConstants::WORD_BITS].fetch_or(mask, std::memory_order_relaxed);
+                }
+            });
+
+            // the joins above order the bit updates before this pass
+            std::vector<std::vector<uint64_t>> retries(threadCount > 0 ? threadCount : 1);
+
+            Parallel::forChunks(hashes.size(), threadCount, PerfectHashConstants::PARALLEL_THRESHOLD, [&](size_t begin, size_t end, unsigned thread) {
+                for (size_t i = begin; i < end; ++i) {
+                    size_t position = positionOf(hashes[i], level, size);
+                    uint64_t mask = uint64_t(1) << (position % PerfectHashConstants::WORD_BITS);
+
+                    if (collided[position / PerfectHashConstants::WORD_BITS].load(std::memory_order_relaxed) & mask)
+                        retries[thread].push_back(hashes[i]);
+                }
+            });
+
+            levels.push_back(Level { bits.size() * PerfectHashConstants::WORD_BITS, size });
+            for (size_t w = 0; w < words; ++w)
+                bits.push_back(taken[w].load(std::memory_order_relaxed) & ~collided[w].load(std::memory_order_relaxed));
+
+            hashes.clear();
+            for (std::vector<uint64_t>& retry : retries)
+                hashes.insert(hashes.end(), retry.begin(), retry.end());
+        }
+
+        buildRanks();
+        return hashes;
+    }
+
+    // index in [0, placedCount()), NOT_FOUND for a hash that was not placed.
+    // A hash that was never given to build() gets NOT_FOUND or any index - the caller has to verify the key.
+    size_t lookup(uint64_t hash) const
+    {
+        for (size_t level = 0; level < levels.size(); ++level) {
+            size_t position = levels[level].bitOffset + positionOf(hash, static_cast<unsigned>(level), levels[level].size);
+
+            if (bits[position / PerfectHashConstants::WORD_BITS] & (uint64_t(1) << (position % PerfectHashConstants::WORD_BITS)))
+                return rank(position);
+        }
+
+        return PerfectHashConstants::NOT_FOUND;
+    }
+
+    size_t placedCount() const { return placed; }
+
+    size_t memoryBytes() const
+    {
+        return bits.size() * sizeof(uint64_t) + rankSamples.size() * sizeof(uint64_t) + levels.size() * sizeof(Level);
+    }
+
+private:
+    static size_t roundToWords(size_t size)
+    {
+        size_t words = (std::max<size_t>(size, 1) + PerfectHashConstants::WORD_BITS - 1) / PerfectHashConstants::WORD_BITS;
+        return words * PerfectHashConstants::WORD_BITS;
+    }
+
+    // a differently seeded hash for every level
+    static size_t positionOf(uint64_t hash, unsigned level, size_t size)
+    {
+        return static_cast<size_t>(Hashing::mix64(hash + (level + 1) * Hashing::FIBONACCI_MULTIPLIER) % size);
+    }
+
+    void buildRanks()
+    {
+        rankSamples.clear();
+        placed = 0;
+
+        for (size_t w = 0; w < bits.size(); ++w) {
+            if (w % PerfectHashConstants::WORDS_PER_RANK_BLOCK == 0)
+                rankSamples.push_back(placed);
+
+            placed += PerfectHashDetail::popcount(bits[w]);
+        }
+    }
+
+    // set bits before position
+    size_t rank(size_t position) const
+    {
+        size_t word = position / PerfectHashConstants::WORD_BITS;
+        size_t block = word / PerfectHashConstants::WORDS_PER_RANK_BLOCK;
+
+        size_t result = static_cast<size_t>(rankSamples[block]);
+        for (size_t w = block * PerfectHashConstants::WORDS_PER_RANK_BLOCK; w < word; ++w)
+            result += PerfectHashDetail::popcount(bits[w]);
+
+        uint64_t below = (uint64_t(1) << (position % PerfectHashConstants::WORD_BITS)) - 1;
+        return result + PerfectHashDetail::popcount(bits[word] & below);
+    }
+
+    std::vector<Level> levels;
+    std::vector<uint64_t> bits;
+    std::vector<uint64_t> rankSamples;
+    size_t placed = 0;
+};
+
+// Static key set -> dense indexes [0, size()): a MinimalPerfectHash plus the keys themselves,
+// stored at their index so a lookup can tell a member from a stranger with one comparison.
+// The few keys the function could not place live in a small UnorderedMap after the placed ones.
+template <typename Key, typename Hasher>
+class PerfectHashIndex {
+public:
+    // takes the keys (distinct), returns for every index the position its key had in keys
+    std::vector<size_t> build(std::vector<Key> input, unsigned threadCount)
+    {
+        threadCount = Parallel::resolveThreadCount(threadCount);
+
+        std::vector<uint64_t> hashes(input.size());
+        Parallel::forChunks(input.size(), threadCount, PerfectHashConstants::PARALLEL_THRESHOLD, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i)
+                hashes[i] = static_cast<uint64_t>(hasher(input[i]));
+        });
+
+        function.build(hashes, threadCount);
+        size_t placed = function.placedCount();
+
+        std::vector<size_t> sourceOf(input.size(), PerfectHashConstants::NOT_FOUND);
+        std::vector<uint8_t> isPlaced(input.size(), 0);
+
+        // indexes are distinct, so the threads never write the same element
+        Parallel::forChunks(input.size(), threadCount, PerfectHashConstants::PARALLEL_THRESHOLD, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                size_t index = function.lookup(hashes[i]);
+                if (index != PerfectHashConstants::NOT_FOUND) {
+                    sourceOf[index] = i;
+                    isPlaced[i] = 1;
+                }
+            }
+        });
+
+        overflow.clear();
+        size_t next = placed;
+        for (size_t i = 0; i < input.size(); ++i) {
+            if (!isPlaced[i]) {
+                overflow.insert(input[i], next);
+                sourceOf[next++] = i;
+            }
+        }
+
+        keys.clear();
+        keys.reserve(input.size());
+        for (size_t source : sourceOf)
+            keys.push_back(std::move(input[source]));
+
+        return sourceOf;
+    }
+
+    // O(const): one function lookup and one key comparison; NOT_FOUND for keys outside the set
+    size_t indexOf(const Key& key) const
+    {
+        size_t index = function.lookup(static_cast<uint64_t>(hasher(key)));
+
+        if (index != PerfectHashConstants::NOT_FOUND)
+            return keys[index] == key ? index : PerfectHashConstants::NOT_FOUND;
+
+        if (overflow.empty())
+            return PerfectHashConstants::NOT_FOUND;
+
+        auto iter = overflow.find(key, overflow.hashOf(key));
+        return iter != overflow.cend() ? iter->second : PerfectHashConstants::NOT_FOUND;
+    }
+
+    const Key& keyAt(size_t index) const { return keys[index]; }
+
+    size_t size() const { return keys.size(); }
+
+    // the function alone, without the stored keys
+    double bitsPerKey() const
+    {
+        return keys.empty() ? 0.0 : 8.0 * function.memoryBytes() / keys.size();
+    }
+
+private:
+    MinimalPerfectHash function;
+    std::vector<Key> keys;
+    UnorderedMap<Key, size_t, Hasher> overflow;
+    Hasher hasher;
+};
+
+// Read-only set built once from an UnorderedSet; construction is spread over threadCount threads
+// (0 = one per core).
+template <typename T, typename Hasher = std::hash<T>>
+class PerfectHashSet {
+public:
+    template <typename SourceHasher, typename Reduction>
+    explicit PerfectHashSet(const UnorderedSet<T, SourceHasher, Reduction>& source, unsigned threadCount = 0)
+    {
+        index.build(std::vector<T>(source.cbegin(), source.cend()), threadCount);
+    }
+
+    // O(const)
+    bool contains(const T& key) const { return index.indexOf(key) != PerfectHashConstants::NOT_FOUND; }
+
+    // position of key in [0, size()), NOT_FOUND if it is not in the set
+    size_t indexOf(const T& key) const { return index.indexOf(key); }
+
+    size_t size() const { return index.size(); }
+    bool empty() const { return size() == 0; }
+
+    double bitsPerKey() const { return index.bitsPerKey(); }
+
+private:
+    PerfectHashIndex<T, Hasher> index;
+};
+
+// Read-only map built once from an UnorderedMap; the values sit in one array in index order.
+template <typename Key, typename Value, typename Hasher = std::hash<Key>>
+class PerfectHashMap {
+public:
+    template <typename SourceHasher, typename Reduction>
+    explicit PerfectHashMap(const UnorderedMap<Key, Value, SourceHasher, Reduction>& source, unsigned threadCount = 0)
+    {
+        std::vector<Key> keys;
+        std::vector<Value> sourceValues;
+        keys.reserve(source.size());
+        sourceValues.reserve(source.size());
+
+        for (auto iter = source.cbegin(); iter != source.cend(); ++iter) {
+            keys.push_back(iter->first);
+            sourceValues.push_back(iter->second);
+        }
+
+        std::vector<size_t> sourceOf = index.build(std::move(keys), threadCount);
+
+        values.reserve(sourceValues.size());
+        for (size_t position : sourceOf)
+            values.push_back(std::move(sourceValues[position]));
+    }
+
+    // O(const)
+    bool contains(const Key& key) const { return index.indexOf(key) != PerfectHashConstants::NOT_FOUND; }
+
+    // O(const), nullptr if there is no such key
+    const Value* find(const Key& key) const
+    {
+        size_t position = index.indexOf(key);
+        return position != PerfectHashConstants::NOT_FOUND ? &values[position] : nullptr;
+    }
+
+    const Value& get(const Key& key) const
+    {
+        const Value* value = find(key);
+        if (!value)
+            throw std::runtime_error("Element not found");
+
+        return *value;
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return size() == 0; }
+
+    double bitsPerKey() const { return index.bitsPerKey(); }
+
+private:
+    PerfectHashIndex<Key, Hasher> index;
+    std::vector<Value> values;
+};
@@ -0,0 +1,535 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "HashFunctions.h"
+#include "TransparentHash.h"
+
+namespace PersistentHashMapConstants {
+constexpr unsigned BITS_PER_LEVEL = 5; // 32-way nodes
+constexpr uint32_t LEVEL_MASK = (1u << BITS_PER_LEVEL) - 1;
+// past the last level the whole 64 bit hash is used up, keys there really collide
+constexpr unsigned HASH_BITS = 64;
+};
+
+// Immutable hash map: a hash array mapped trie (CHAMP layout).
+// Every node has two 32 bit bitmaps over the next 5 hash bits - which positions hold an entry inline
+// and which a child node - and stores only the present ones, packed; a position's slot is the popcount
+// of the bitmap below its bit. Nodes are shared between versions, so
+//   - a copy (snapshot) is O(const): one shared pointer,
+//   - insert / assign / remove return a new version in O(log32 n) by copying only the path to the key,
+//     and the old version stays valid and unchanged (safe to read from other threads meanwhile).
+// For many updates in a row transient() gives a mutable builder that edits the nodes it created in place,
+// and persistent() turns it back into a map in O(const).
+template <typename Key, typename Value, typename Hasher = std::hash<Key>>
+class PersistentHashMap {
+public:
+    typedef std::pair<Key, Value> DataType;
+
+private:
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename K>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<K>, Key>, int>;
+
+    struct Entry {
+        DataType data;
+        uint64_t hash;
+    };
+
+    struct Node;
+    typedef std::shared_ptr<Node> NodePtr;
+
+    struct Node {
+        uint32_t dataMap = 0;
+        uint32_t nodeMap = 0;
+        std::vector<Entry> entries; // past the last level: all the colliding entries, no bitmaps
+        std::vector<NodePtr> children;
+        uint64_t owner = 0; // the transient allowed to edit this node in place, 0 for none
+    };
+
+public:
+    class Transient;
+    class ConstIterator;
+
+    PersistentHashMap() = default;
+
+    size_t size() const { return sz; }
+    bool empty() const { return sz == 0; }
+
+    // O(log32 n)
+    bool contains(const Key& key) const { return findEntry(root, hashOf(key), key) != nullptr; }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& key) const { return findEntry(root, hashOf(key), key) != nullptr; }
+
+    // O(log32 n)
+    const Value& get(const Key& key) const { return getImpl(root, key); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    const Value& get(const K& key) const { return getImpl(root, key); }
+
+    // O(log32 n); nullptr if there is no such key
+    const Value* find(const Key& key) const
+    {
+        const Entry* entry = findEntry(root, hashOf(key), key);
+        return entry ? &entry->data.second : nullptr;
+    }
+
+    // O(log32 n): the map with key added, or this map if key is already there (like UnorderedMap::insert)
+    PersistentHashMap insert(const Key& key, const Value& value) const { return update(key, value, false); }
+
+    // O(log32 n): the map with key mapped to value, overwriting
+    PersistentHashMap assign(const Key& key, const Value& value) const { return update(key, value, true); }
+
+    // O(log32 n): the map without key
+    PersistentHashMap remove(const Key& key) const
+    {
+        bool removed = false;
+        NodePtr newRoot = root ? removeFrom(root, hashOf(key), key, 0, 0, removed) : root;
+
+        return removed ? PersistentHashMap(newRoot, sz - 1) : *this;
+    }
+
+    // O(const): a mutable builder starting from this map
+    Transient transient() const { return Transient(root, sz); }
+
+    // any order, but the same for equal versions
+    ConstIterator cbegin() const { return ConstIterator(root.get()); }
+    ConstIterator cend() const { return ConstIterator(nullptr); }
+    ConstIterator begin() const { return cbegin(); }
+    ConstIterator end() const { return cend(); }
+
+    // Batched mutation: nodes this transient created itself are edited in place instead of copied,
+    // so n updates cost about n path walks rather than n path copies.
+    // The map it came from is never touched; one transient must not be used from two threads at once.
+    class Transient {
+    public:
+        // a copy would share the owner token, and the two would then edit each other's nodes in place
+        Transient(const Transient&) = delete;
+        Transient& operator=(const Transient&) = delete;
+
+        // the moved-from transient is empty and gets a token of its own
+        Transient(Transient&& other) noexcept
+            : root(std::move(other.root))
+            , sz(other.sz)
+            , owner(other.owner)
+        {
+            other.reset();
+        }
+
+        Transient& operator=(Transient&& other) noexcept
+        {
+            if (this != &other) {
+                root = std::move(other.root);
+                sz = other.sz;
+                owner = other.owner;
+                other.reset();
+            }
+            return *this;
+        }
+
+        size_t size() const { return sz; }
+        bool empty() const { return sz == 0; }
+
+        bool contains(const Key& key) const { return findEntry(root, hashOf(key), key) != nullptr; }
+        const Value& get(const Key& key) const { return getImpl(root, key); }
+
+        // returns whether key was new
+        bool insert(const Key& key, const Value& value) { return updateInPlace(key, value, false); }
+        bool assign(const Key& key, const Value& value) { return updateInPlace(key, value, true); }
+
+        bool remove(const Key& key)
+        {
+            if (!root)
+                return false;
+
+            bool removed = false;
+            root = removeFrom(root, hashOf(key), key, 0, owner, removed);
+            sz -= removed;
+
+            return removed;
+        }
+
+        // O(const). The transient stays usable, but from now on it copies the nodes it shares with the result
+        PersistentHashMap persistent()
+        {
+            owner = nextOwner();
+            return PersistentHashMap(root, sz);
+        }
+
+    private:
+        friend class PersistentHashMap;
+
+        Transient(NodePtr root, size_t sz)
+            : root(std::move(root))
+            , sz(sz)
+            , owner(nextOwner())
+        {
+        }
+
+        void reset() noexcept
+        {
+            root = nullptr;
+            sz = 0;
+            owner = nextOwner();
+        }
+
+        bool updateInPlace(const Key& key, const Value& value, bool overwrite)
+        {
+            bool added = false;
+            root = insertInto(root, Entry { DataType(key, value), hashOf(key) }, 0, owner, overwrite, added);
+            sz += added;
+
+            return added;
+        }
+
+        NodePtr root;
+        size_t sz;
+        uint64_t owner;
+    };
+
+    class ConstIterator {
+    public:
+        ConstIterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+
+        ConstIterator operator++(int)
+        {
+            ConstIterator old(*this);
+            advance();
+            return old;
+        }
+
+        const DataType& operator*() const { return *current; }
+        const DataType* operator->() const { return current; }
+
+        bool operator==(const ConstIterator& rhs) const { return current == rhs.current; }
+        bool operator!=(const ConstIterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class PersistentHashMap;
+
+        // a node's own entries first, then its children depth first
+        struct Frame {
+            const Node* node;
+            size_t entry;
+            size_t child;
+        };
+
+        explicit ConstIterator(const Node* root)
+        {
+            if (root) {
+                stack.push_back(Frame { root, 0, 0 });
+                advance();
+            }
+        }
+
+        void advance()
+        {
+            while (!stack.empty()) {
+                Frame& top = stack.back();
+
+                if (top.entry < top.node->entries.size()) {
+                    current = &top.node->entries[top.entry++].data;
+                    return;
+                }
+
+                if (top.child < top.node->children.size()) {
+                    const Node* child = top.node->children[top.child++].get();
+                    stack.push_back(Frame { child, 0, 0 }); // invalidates top
+                    continue;
+                }
+
+                stack.pop_back();
+            }
+
+            current = nullptr;
+        }
+
+        std::vector<Frame> stack; // at most one frame per level
+        const DataType* current = nullptr;
+    };
+
+private:
+    PersistentHashMap(NodePtr root, size_t sz)
+        : root(std::move(root))
+        , sz(sz)
+    {
+    }
+
+    // the trie consumes the hash 5 bits at a time, so the bits have to be mixed even for an identity hasher
+    template <typename K>
+    static uint64_t hashOf(const K& key) { return Hashing::mix64(Hasher()(key)); }
+
+    static unsigned popcount(uint32_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_popcount(word));
+#else
+        unsigned count = 0;
+        for (; word; word &= word - 1)
+            ++count;
+        return count;
+#endif
+    }
+
+    static uint32_t bitAt(uint64_t hash, unsigned shift)
+    {
+        return 1u << ((hash >> shift) & PersistentHashMapConstants::LEVEL_MASK);
+    }
+
+    // where the element for bit sits among the present ones
+    static size_t slotOf(uint32_t bitmap, uint32_t bit) { return popcount(bitmap & (bit - 1)); }
+
+    static bool isCollisionLevel(unsigned shift) { return shift >= PersistentHashMapConstants::HASH_BITS; }
+
+    static uint64_t nextOwner()
+    {
+        static std::atomic<uint64_t> counter { 0 };
+        return ++counter;
+    }
+
+    // node itself if the transient owner may edit it, otherwise a copy that it may
+    static NodePtr editable(const NodePtr& node, uint64_t owner)
+    {
+        if (owner != 0 && node->owner == owner)
+            return node;
+
+        NodePtr copy = std::make_shared<Node>(*node);
+        copy->owner = owner;
+        return copy;
+    }
+
+    template <typename K>
+    static const Entry* findEntry(const NodePtr& root, uint64_t hash, const K& key)
+    {
+        const Node* node = root.get();
+
+        for (unsigned shift = 0; node; shift += PersistentHashMapConstants::BITS_PER_LEVEL) {
+            if (isCollisionLevel(shift)) {
+                for (const Entry& entry : node->entries)
+                    if (entry.data.first == key)
+                        return &entry;
+
+                return nullptr;
+            }
+
+            uint32_t bit = bitAt(hash, shift);
+
+            if (node->dataMap & bit) {
+                const Entry& entry = node->entries[slotOf(node->dataMap, bit)];
+                return entry.hash == hash && entry.data.first == key ? &entry : nullptr;
+            }
+
+            node = node->nodeMap & bit ? node->children[slotOf(node->nodeMap, bit)].get() : nullptr;
+        }
+
+        return nullptr;
+    }
+
+    template <typename K>
+    static const Value& getImpl(const NodePtr& root, const K& key)
+    {
+        const Entry* entry = findEntry(root, hashOf(key), key);
+        if (!entry)
+            throw std::runtime_error("Element not found");
+
+        return entry->data.second;
+    }
+
+    PersistentHashMap update(const Key& key, const Value& value, bool overwrite) const
+    {
+        bool added = false;
+        NodePtr newRoot = insertInto(root, Entry { DataType(key, value), hashOf(key) }, 0, 0, overwrite, added);
+
+        return PersistentHashMap(newRoot, sz + added);
+    }
+
+    // returns the node to put in place of node - node itself when nothing changed or it was edited in place
+    static NodePtr insertInto(const NodePtr& node, const Entry& entry, unsigned shift, uint64_t owner, bool overwrite, bool& added)
+    {
+        if (!node) {
+            NodePtr created = std::make_shared<Node>();
+            created->owner = owner;
+            created->dataMap = bitAt(entry.hash, shift);
+            created->entries.push_back(entry);
+            added = true;
+            return created;
+        }
+
+        if (isCollisionLevel(shift)) {
+            for (size_t i = 0; i < node->entries.size(); ++i)
+                if (node->entries[i].data.first == entry.data.first)
+                    return overwrite ? overwritten(node, i, entry, owner) : node;
+
+            NodePtr edited = editable(node, owner);
+            edited->entries.push_back(entry);
+            added = true;
+            return edited;
+        }
+
+        uint32_t bit = bitAt(entry.hash, shift);
+
+        if (node->dataMap & bit) {
+            size_t slot = slotOf(node->dataMap, bit);
+            const Entry& existing = node->entries[slot];
+
+            if (existing.hash == entry.hash && existing.data.first == entry.data.first)
+                return overwrite ? overwritten(node, slot, entry, owner) : node;
+
+            // two keys on one position: both move one level down
+            NodePtr merged = mergeEntries(existing, entry, shift + PersistentHashMapConstants::BITS_PER_LEVEL, owner);
+
+            NodePtr edited = editable(node, owner);
+            edited->entries.erase(edited->entries.begin() + slot);
+            edited->dataMap ^= bit;
+            edited->nodeMap |= bit;
+            edited->children.insert(edited->children.begin() + slotOf(edited->nodeMap, bit), std::move(merged));
+            added = true;
+            return edited;
+        }
+
+        if (node->nodeMap & bit) {
+            size_t slot = slotOf(node->nodeMap, bit);
+            const NodePtr& child = node->children[slot];
+            NodePtr newChild = insertInto(child, entry, shift + PersistentHashMapConstants::BITS_PER_LEVEL, owner, overwrite, added);
+
+            if (newChild == child)
+                return node;
+
+            NodePtr edited = editable(node, owner);
+            edited->children[slot] = std::move(newChild);
+            return edited;
+        }
+
+        NodePtr edited = editable(node, owner);
+        edited->entries.insert(edited->entries.begin() + slotOf(node->dataMap, bit), entry);
+        edited->dataMap |= bit;
+        added = true;
+        return edited;
+    }
+
+    static NodePtr overwritten(const NodePtr& node, size_t slot, const Entry& entry, uint64_t owner)
+    {
+        NodePtr edited = editable(node, owner);
+        edited->entries[slot].data.second = entry.data.second;
+        return edited;
+    }
+
+    // the smallest subtrie holding two entries whose hashes agree up to shift
+    static NodePtr mergeEntries(const Entry& first, const Entry& second, unsigned shift, uint64_t owner)
+    {
+        NodePtr node = std::make_shared<Node>();
+        node->owner = owner;
+
+        if (isCollisionLevel(shift)) {
+            node->entries = { first, second };
+            return node;
+        }
+
+        uint32_t firstBit = bitAt(first.hash, shift);
+        uint32_t secondBit = bitAt(second.hash, shift);
+
+        if (firstBit == secondBit) {
+            node->nodeMap = firstBit;
+            node->children.push_back(mergeEntries(first, second, shift + PersistentHashMapConstants::BITS_PER_LEVEL, owner));
+        } else {
+            node->dataMap = firstBit | secondBit;
+            node->entries = firstBit < secondBit ? std::vector<Entry> { first, second } : std::vector<Entry> { second, first };
+        }
+
+        return node;
+    }
+
+    // returns the node to put in place of node, nullptr once it is empty.
+    // A child left with a single entry and no children is pulled up into its parent,
+    // so a removal undoes what the matching insertion built
+    static NodePtr removeFrom(const NodePtr& node, uint64_t hash, const Key& key, unsigned shift, uint64_t owner, bool& removed)
+    {
+        if (isCollisionLevel(shift)) {
+            for (size_t i = 0; i < node->entries.size(); ++i) {
+                if (node->entries[i].data.first == key) {
+                    removed = true;
+                    if (node->entries.size() == 1)
+                        return nullptr;
+
+                    NodePtr edited = editable(node, owner);
+                    edited->entries.erase(edited->entries.begin() + i);
+                    return edited;
+                }
+            }
+
+            return node;
+        }
+
+        uint32_t bit = bitAt(hash, shift);
+
+        if (node->dataMap & bit) {
+            size_t slot = slotOf(node->dataMap, bit);
+            const Entry& existing = node->entries[slot];
+
+            if (existing.hash != hash || !(existing.data.first == key))
+                return node;
+
+            removed = true;
+            if (node->entries.size() == 1 && node->children.empty())
+                return nullptr;
+
+            NodePtr edited = editable(node, owner);
+            edited->entries.erase(edited->entries.begin() + slot);
+            edited->dataMap ^= bit;
+            return edited;
+        }
+
+        if (!(node->nodeMap & bit))
+            return node;
+
+        size_t slot = slotOf(node->nodeMap, bit);
+        const NodePtr& child = node->children[slot];
+        NodePtr newChild = removeFrom(child, hash, key, shift + PersistentHashMapConstants::BITS_PER_LEVEL, owner, removed);
+
+        if (!removed)
+            return node;
+
+        if (!newChild) {
+            if (node->children.size() == 1 && node->entries.empty())
+                return nullptr;
+
+            NodePtr edited = editable(node, owner);
+            edited->children.erase(edited->children.begin() + slot);
+            edited->nodeMap ^= bit;
+            return edited;
+        }
+
+        if (newChild->entries.size() == 1 && newChild->children.empty()) {
+            Entry pulledUp = newChild->entries.front();
+
+            NodePtr edited = editable(node, owner);
+            edited->children.erase(edited->children.begin() + slot);
+            edited->nodeMap ^= bit;
+            edited->entries.insert(edited->entries.begin() + slotOf(edited->dataMap, bit), std::move(pulledUp));
+            edited->dataMap |= bit;
+            return edited;
+        }
+
+        if (newChild == child)
+            return node;
+
+        NodePtr edited = editable(node, owner);
+        edited->children[slot] = std::move(newChild);
+        return edited;
+    }
+
+    NodePtr root;
+    size_t sz = 0;
+};
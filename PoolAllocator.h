@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace PoolAllocatorConstants {
+// slots come in multiples of SLOT_ALIGNMENT up to MAX_SLOT_SIZE, bigger blocks go to the heap
+constexpr size_t SLOT_ALIGNMENT = alignof(std::max_align_t);
+constexpr size_t MAX_SLOT_SIZE = 256;
+constexpr size_t SIZE_CLASSES = MAX_SLOT_SIZE / SLOT_ALIGNMENT;
+constexpr size_t INIT_SLOTS_PER_CHUNK = 32;
+constexpr size_t MAX_SLOTS_PER_CHUNK = 4096;
+constexpr size_t GROWTH_FACTOR = 2;
+};
+
+// Free lists of fixed size slots carved out of big chunks, one list per size class.
+// Node based containers allocate the same few node sizes over and over, so a freed node
+// is handed out again in O(const) without touching the heap, and the chunks are freed all at once:
+// on release() or in the destructor. They are kept even when every slot has been given back,
+// so a container that keeps emptying and refilling reuses the same chunks.
+// Not thread safe.
+class NodePool {
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool() { freeChunks(); }
+
+    // O(const) for blocks up to MAX_SLOT_SIZE
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        if (bytes > PoolAllocatorConstants::MAX_SLOT_SIZE || alignment > PoolAllocatorConstants::SLOT_ALIGNMENT)
+            return ::operator new(bytes, std::align_val_t(std::max(alignment, PoolAllocatorConstants::SLOT_ALIGNMENT)));
+
+        SizeClass& sizeClass = classes[classOf(bytes)];
+        if (!sizeClass.freeList)
+            addChunk(sizeClass, classOf(bytes));
+
+        FreeSlot* slot = sizeClass.freeList;
+        sizeClass.freeList = slot->next;
+        ++liveSlots;
+
+        return slot;
+    }
+
+    void deallocate(void* pointer, size_t bytes, size_t alignment)
+    {
+        if (bytes > PoolAllocatorConstants::MAX_SLOT_SIZE || alignment > PoolAllocatorConstants::SLOT_ALIGNMENT) {
+            ::operator delete(pointer, std::align_val_t(std::max(alignment, PoolAllocatorConstants::SLOT_ALIGNMENT)));
+            return;
+        }
+
+        SizeClass& sizeClass = classes[classOf(bytes)];
+        sizeClass.freeList = new (pointer) FreeSlot { sizeClass.freeList };
+        --liveSlots;
+    }
+
+    // Gives every chunk back to the heap. Whatever was allocated from the pool must not be touched afterwards
+    void release()
+    {
+        freeChunks();
+        chunks.clear();
+
+        for (SizeClass& sizeClass : classes)
+            sizeClass = SizeClass {};
+
+        liveSlots = 0;
+    }
+
+    size_t live_slots() const { return liveSlots; }
+
+    size_t bytes_reserved() const
+    {
+        size_t total = 0;
+        for (const Chunk& chunk : chunks)
+            total += chunk.size;
+
+        return total;
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct SizeClass {
+        FreeSlot* freeList = nullptr;
+        size_t nextChunkSlots = PoolAllocatorConstants::INIT_SLOTS_PER_CHUNK;
+    };
+
+    struct Chunk {
+        void* memory;
+        size_t size;
+    };
+
+    static size_t classOf(size_t bytes)
+    {
+        return bytes == 0 ? 0 : (bytes - 1) / PoolAllocatorConstants::SLOT_ALIGNMENT;
+    }
+
+    // threads a new chunk onto the free list of the class
+    void addChunk(SizeClass& sizeClass, size_t classIndex)
+    {
+        size_t slotSize = (classIndex + 1) * PoolAllocatorConstants::SLOT_ALIGNMENT;
+        size_t slots = sizeClass.nextChunkSlots;
+
+        char* memory = static_cast<char*>(::operator new(slots * slotSize));
+        chunks.push_back(Chunk { memory, slots * slotSize });
+
+        for (size_t i = slots; i-- > 0;)
+            sizeClass.freeList = new (memory + i * slotSize) FreeSlot { sizeClass.freeList };
+
+        sizeClass.nextChunkSlots = std::min(slots * PoolAllocatorConstants::GROWTH_FACTOR, PoolAllocatorConstants::MAX_SLOTS_PER_CHUNK);
+    }
+
+    void freeChunks()
+    {
+        for (const Chunk& chunk : chunks)
+            ::operator delete(chunk.memory);
+    }
+
+    SizeClass classes[PoolAllocatorConstants::SIZE_CLASSES];
+    std::vector<Chunk> chunks;
+    size_t liveSlots = 0;
+};
+
+// std compatible allocator on a shared NodePool. A default constructed one gets a pool of its own,
+// so a container given no allocator still pools its nodes; copies and rebinds share the pool
+// (the containers' chains splice nodes between each other, which needs equal allocators).
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    PoolAllocator()
+        : pool(std::make_shared<NodePool>())
+    {
+    }
+
+    explicit PoolAllocator(std::shared_ptr<NodePool> pool)
+        : pool(std::move(pool))
+    {
+    }
+
+    // moving copies, so a moved-from container still has a pool
+    PoolAllocator(const PoolAllocator&) = default;
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other)
+        : pool(other.pool)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+
+        return static_cast<T*>(pool->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* pointer, size_t count) { pool->deallocate(pointer, count * sizeof(T), alignof(T)); }
+
+    NodePool& resource() const { return *pool; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& rhs) const { return pool == rhs.pool; }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& rhs) const { return pool != rhs.pool; }
+
+private:
+    template <typename U>
+    friend class PoolAllocator;
+
+    std::shared_ptr<NodePool> pool;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace PrefetchConstants {
+// keys hashed and prefetched before the first one of them is compared:
+// enough misses in flight to hide memory latency, few enough that the lines are still cached when used
+constexpr size_t BATCH_SIZE = 16;
+};
+
+// only a hint - it never faults, so any address is fine
+inline void prefetchForRead(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
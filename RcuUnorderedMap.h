@@ -0,0 +1,344 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "UnorderedMap.h"
+
+namespace RcuConstants {
+constexpr size_t MAX_READER_THREADS = 256;
+constexpr size_t CACHE_LINE_SIZE = 64;
+// unpublished tables waiting for their grace period; past this many a writer waits for the readers instead
+constexpr size_t MAX_RETIRED_TABLES = 16;
+};
+
+// Epoch based grace periods, shared by all RcuUnorderedMaps in the process.
+// Every reader thread owns one slot (on its own cache line) where it announces the epoch
+// it entered its read side section in, 0 meaning "not reading". Readers only ever write their own slot.
+// A writer that unpublished a table bumps the global epoch (retire()); once no slot holds an older epoch
+// (isQuiescent(), or waiting for it with synchronize()) nobody can still be looking at the old table.
+namespace RcuDomain {
+struct alignas(RcuConstants::CACHE_LINE_SIZE) ReaderSlot {
+    std::atomic<uint64_t> epoch { 0 };
+    std::atomic<bool> taken { false };
+};
+
+inline ReaderSlot readerSlots[RcuConstants::MAX_READER_THREADS];
+inline std::atomic<uint64_t> globalEpoch { 1 };
+
+// claims a slot the first time a thread reads, gives it back when the thread exits
+class ThreadRegistration {
+public:
+    ThreadRegistration()
+    {
+        for (size_t i = 0; i < RcuConstants::MAX_READER_THREADS; ++i) {
+            bool expected = false;
+            if (readerSlots[i].taken.compare_exchange_strong(expected, true)) {
+                slot = &readerSlots[i];
+                return;
+            }
+        }
+
+        throw std::runtime_error("Too many reader threads");
+    }
+
+    ~ThreadRegistration() { slot->taken.store(false, std::memory_order_release); }
+
+    ReaderSlot* slot = nullptr;
+    unsigned nesting = 0;
+};
+
+inline ThreadRegistration& currentThread()
+{
+    thread_local ThreadRegistration registration;
+    return registration;
+}
+
+// a read side section; nothing published before it started is reclaimed until it ends
+class ReadGuard {
+public:
+    ReadGuard()
+        : registration(currentThread())
+    {
+        if (registration.nesting++ == 0) {
+            registration.slot->epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // the announcement must be visible before we read any table pointer
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    ~ReadGuard()
+    {
+        if (--registration.nesting == 0)
+            registration.slot->epoch.store(0, std::memory_order_release);
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+private:
+    ThreadRegistration& registration;
+};
+
+// call right after unpublishing a pointer; returns the epoch to pass to isQuiescent() for it
+inline uint64_t retire()
+{
+    return globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+}
+
+// whether every read side section that might have seen a pointer retired at target has ended - never waits
+inline bool isQuiescent(uint64_t target)
+{
+    for (size_t i = 0; i < RcuConstants::MAX_READER_THREADS; ++i) {
+        uint64_t epoch = readerSlots[i].epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0 && epoch < target)
+            return false;
+    }
+
+    return true;
+}
+
+// waits until every read side section that might have seen an already unpublished pointer has ended
+inline void synchronize()
+{
+    uint64_t target = retire();
+
+    for (size_t i = 0; i < RcuConstants::MAX_READER_THREADS; ++i) {
+        for (;;) {
+            uint64_t epoch = readerSlots[i].epoch.load(std::memory_order_seq_cst);
+            if (epoch == 0 || epoch >= target)
+                break;
+            std::this_thread::yield();
+        }
+    }
+}
+};
+
+// Read-mostly map: get/contains never lock; the only shared memory they write is their own epoch slot
+// (on its own cache line, see RcuDomain) - otherwise they just load the current table pointer and look it up.
+// Writers copy the current table, change the copy and publish it with one atomic store, so every write costs O(n):
+//   - concurrent writes are combined - whoever gets the writer lock applies every write queued meanwhile
+//     to one copy, and the others find theirs already done;
+//   - the old table is retired, not waited for: it is freed by a later write once its readers are gone
+//     (only with MAX_RETIRED_TABLES still pending does a writer wait for a grace period).
+// Several changes of one thread still go best into one update().
+// Must not be written to from inside a read() callback on the same thread (a full retired list would wait for itself).
+template <typename Key, typename Value, typename Hasher = std::hash<Key>, typename Reduction = ModuloReduction>
+class RcuUnorderedMap {
+public:
+    typedef UnorderedMap<Key, Value, Hasher, Reduction> Table;
+
+    RcuUnorderedMap()
+        : current(new Table())
+    {
+    }
+
+    RcuUnorderedMap(const RcuUnorderedMap&) = delete;
+    RcuUnorderedMap& operator=(const RcuUnorderedMap&) = delete;
+
+    // nobody may be using the map any more by the time it is destroyed
+    ~RcuUnorderedMap()
+    {
+        delete current.load(std::memory_order_relaxed);
+
+        for (const Retired& old : retired)
+            delete old.table;
+    }
+
+    // lock free; copies the value out because the table may be reclaimed right after the read section
+    bool get(const Key& key, Value& result) const
+    {
+        RcuDomain::ReadGuard guard;
+        const Table* table = current.load(std::memory_order_acquire);
+
+        size_t hash = table->hashOf(key);
+        auto iter = table->find(key, hash);
+        if (iter == table->cend())
+            return false;
+
+        result = iter->second;
+        return true;
+    }
+
+    Value get(const Key& key) const
+    {
+        Value result;
+        if (!get(key, result))
+            throw std::runtime_error("Element not found");
+
+        return result;
+    }
+
+    // lock free
+    bool contains(const Key& key) const
+    {
+        RcuDomain::ReadGuard guard;
+        return current.load(std::memory_order_acquire)->contains(key);
+    }
+
+    // lock free; fn(const Table&) sees one consistent version of the whole map
+    template <typename Function>
+    void read(Function&& fn) const
+    {
+        RcuDomain::ReadGuard guard;
+        fn(*current.load(std::memory_order_acquire));
+    }
+
+    size_t size() const
+    {
+        RcuDomain::ReadGuard guard;
+        return current.load(std::memory_order_acquire)->size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // fn(Table&) gets a private copy of the current version (possibly together with other threads' writes,
+    // applied in the order they were queued); all its changes are published at once.
+    // fn may run on another writer's thread. If it throws, none of its changes are published.
+    template <typename Function>
+    void update(Function&& fn)
+    {
+        auto call = [&fn](Table& table) { fn(table); };
+        PendingWrite write { [](void* function, Table& table) { (*static_cast<decltype(call)*>(function))(table); }, &call };
+
+        {
+            std::lock_guard<std::mutex> guard(pendingLock);
+            pending.push_back(&write);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(writerLock);
+            if (!isDone(write))
+                applyPending();
+        }
+
+        if (write.error)
+            std::rethrow_exception(write.error);
+    }
+
+    bool insert(const Key& key, const Value& value)
+    {
+        bool inserted = false;
+        update([&](Table& table) { inserted = table.insert(key, value).second; });
+        return inserted;
+    }
+
+    bool insert_or_assign(const Key& key, const Value& value)
+    {
+        bool inserted = false;
+        update([&](Table& table) {
+            auto result = table.insert(key, value);
+            if (!result.second)
+                result.first->second = value;
+            inserted = result.second;
+        });
+        return inserted;
+    }
+
+    bool remove(const Key& key)
+    {
+        bool removed = false;
+        update([&](Table& table) { removed = table.remove(key); });
+        return removed;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(writerLock);
+        publish(new Table());
+    }
+
+private:
+    struct PendingWrite {
+        void (*apply)(void*, Table&);
+        void* function;
+        std::exception_ptr error;
+        bool done = false; // guarded by pendingLock
+    };
+
+    struct Retired {
+        Table* table;
+        uint64_t epoch;
+    };
+
+    bool isDone(const PendingWrite& write)
+    {
+        std::lock_guard<std::mutex> guard(pendingLock);
+        return write.done;
+    }
+
+    // called with writerLock held: every queued write goes into one copy.
+    // A write that throws is dropped and the copy is rebuilt from the others, so its partial changes never show up.
+    void applyPending()
+    {
+        std::vector<PendingWrite*> batch;
+        {
+            std::lock_guard<std::mutex> guard(pendingLock);
+            batch.swap(pending);
+        }
+
+        for (bool rebuild = true; rebuild;) {
+            rebuild = false;
+            std::unique_ptr<Table> newTable(new Table(*current.load(std::memory_order_relaxed)));
+            size_t applied = 0;
+
+            for (PendingWrite* write : batch) {
+                if (write->error)
+                    continue;
+
+                try {
+                    write->apply(write->function, *newTable);
+                    ++applied;
+                } catch (...) {
+                    write->error = std::current_exception();
+                    rebuild = true;
+                    break;
+                }
+            }
+
+            if (!rebuild && applied > 0)
+                publish(newTable.release());
+        }
+
+        std::lock_guard<std::mutex> guard(pendingLock);
+        for (PendingWrite* write : batch)
+            write->done = true;
+    }
+
+    // called with writerLock held
+    void publish(Table* newTable)
+    {
+        Table* oldTable = current.exchange(newTable, std::memory_order_seq_cst);
+        retired.push_back(Retired { oldTable, RcuDomain::retire() });
+
+        reclaim();
+    }
+
+    // frees the retired tables nobody can be reading any more (oldest first, they were retired in epoch order)
+    void reclaim()
+    {
+        if (retired.size() > RcuConstants::MAX_RETIRED_TABLES)
+            RcuDomain::synchronize(); // the readers are too slow, wait for them once instead of piling up copies
+
+        size_t freed = 0;
+        while (freed < retired.size() && RcuDomain::isQuiescent(retired[freed].epoch))
+            delete retired[freed++].table;
+
+        retired.erase(retired.begin(), retired.begin() + freed);
+    }
+
+    std::atomic<Table*> current;
+    std::mutex writerLock;
+    std::vector<Retired> retired; // guarded by writerLock
+
+    std::mutex pendingLock;
+    std::vector<PendingWrite*> pending;
+};
@@ -1,6 +1,15 @@
 #pragma once
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace SinglyLinkedListConstants {
+constexpr size_t MIN_SLAB_NODES = 16;
+}
 
 template <typename T>
 class SinglyLinkedList {
@@ -16,6 +25,18 @@ private:
         }
     };
 
+    // nodes are carved out of slabs - one contiguous block holds many nodes,
+    // so building a list of n elements costs O(log n) allocations instead of n
+    struct Slab {
+        Slab* next;
+        size_t capacity;
+    };
+
+    // released nodes are kept here (in the raw node memory) until the slabs are dropped
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
 public:
     SinglyLinkedList()
         : head(nullptr)
@@ -24,6 +45,15 @@ public:
     {
     }
 
+    template <typename InputIt>
+    SinglyLinkedList(InputIt first, InputIt last)
+        : head(nullptr)
+        , tail(nullptr)
+        , size(0)
+    {
+        pushBack(first, last);
+    }
+
     SinglyLinkedList(const SinglyLinkedList<T>& other)
         : head(nullptr)
         , tail(nullptr)
@@ -38,7 +68,7 @@ public:
             free();
             copy(other);
         }
-        return this;
+        return *this;
     }
 
     ~SinglyLinkedList() { free(); }
@@ -57,7 +87,7 @@ public:
             free();
             move(std::move(other));
         }
-        return this;
+        return *this;
     }
 
     class iterator {
@@ -206,7 +236,7 @@ public:
         if (iter == cend())
             return end();
 
-        Node* newNode = new Node(data);
+        Node* newNode = createNode(data);
         Node* current = iter.current;
 
         newNode->next = current->next;
@@ -230,7 +260,7 @@ public:
         if (toDelete == tail)
             tail = current;
 
-        delete toDelete;
+        destroyNode(toDelete);
         --size;
 
         return iterator(newNext);
@@ -279,7 +309,7 @@ public:
 
     void pushFront(const T& data)
     {
-        Node* newNode = new Node(data, head);
+        Node* newNode = createNode(data, head);
         head = newNode;
 
         size++;
@@ -290,7 +320,7 @@ public:
 
     void pushBack(const T& data)
     {
-        Node* newNode = new Node(data);
+        Node* newNode = createNode(data);
 
         size++;
 
@@ -303,18 +333,31 @@ public:
         tail = newNode;
     }
 
+    // appends the whole range; for forward iterators all nodes come from (at most) one new slab
+    template <typename InputIt>
+    void pushBack(InputIt first, InputIt last)
+    {
+        typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>)
+            reserveNodes(static_cast<size_t>(std::distance(first, last)));
+
+        for (; first != last; ++first)
+            pushBack(*first);
+    }
+
     void popFront()
     {
         if (empty())
             throw std::runtime_error("Cannot pop element from empty list.");
 
         if (head == tail) {
-            delete head;
+            destroyNode(head);
             head = tail = nullptr;
         } else {
             Node* toDelete = head;
             head = head->next;
-            delete toDelete;
+            destroyNode(toDelete);
         }
 
         --size;
@@ -336,12 +379,19 @@ public:
         std::swap(head, tail);
     }
 
+    // for trivially destructible T this does not touch the nodes at all, it just drops the slabs
+    void clear() { free(); }
+
 private:
     void copy(const SinglyLinkedList<T>& other)
     {
+        reserveNodes(other.size);
+
         Node* current = other.head;
-        while (current)
+        while (current) {
             pushBack(current->data);
+            current = current->next;
+        }
     }
 
     void move(SinglyLinkedList<T>&& other)
@@ -349,27 +399,121 @@ private:
         head = other.head;
         tail = other.tail;
         size = other.size;
+        slabs = other.slabs;
+        slabUsed = other.slabUsed;
+        freeSlots = other.freeSlots;
 
         other.head = other.tail = nullptr;
         other.size = 0;
+        other.slabs = nullptr;
+        other.slabUsed = 0;
+        other.freeSlots = nullptr;
     }
 
     void free()
     {
-        Node* current = head;
-        while (current) {
-            Node* toDelete = current;
-            current = current->next;
-            delete toDelete;
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            Node* current = head;
+            while (current) {
+                Node* toDestroy = current;
+                current = current->next;
+                toDestroy->~Node();
+            }
+        }
+
+        while (slabs) {
+            Slab* toDelete = slabs;
+            slabs = slabs->next;
+            ::operator delete(toDelete, std::align_val_t(SLAB_ALIGNMENT));
         }
 
         head = tail = nullptr;
         size = 0;
+        slabUsed = 0;
+        freeSlots = nullptr;
+    }
+
+    static constexpr size_t SLAB_ALIGNMENT = alignof(Slab) > alignof(Node) ? alignof(Slab) : alignof(Node);
+    static constexpr size_t SLAB_HEADER_SIZE = (sizeof(Slab) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+
+    static Node* slabNodes(Slab* slab)
+    {
+        return reinterpret_cast<Node*>(reinterpret_cast<char*>(slab) + SLAB_HEADER_SIZE);
+    }
+
+    // O(const) amortized: free slot, else the rest of the newest slab, else a new slab
+    void* allocateSlot()
+    {
+        if (freeSlots) {
+            FreeSlot* slot = freeSlots;
+            freeSlots = slot->next;
+            return slot;
+        }
+
+        if (!slabs || slabUsed == slabs->capacity)
+            addSlab(size > SinglyLinkedListConstants::MIN_SLAB_NODES ? size : SinglyLinkedListConstants::MIN_SLAB_NODES);
+
+        return slabNodes(slabs) + slabUsed++;
+    }
+
+    void addSlab(size_t capacity)
+    {
+        // whatever is left in the current slab goes to the free list, so it is not lost
+        if (slabs) {
+            Node* nodes = slabNodes(slabs);
+            for (size_t i = slabUsed; i < slabs->capacity; ++i)
+                releaseSlot(nodes + i);
+        }
+
+        void* memory = ::operator new(SLAB_HEADER_SIZE + capacity * sizeof(Node), std::align_val_t(SLAB_ALIGNMENT));
+        Slab* slab = static_cast<Slab*>(memory);
+        slab->next = slabs;
+        slab->capacity = capacity;
+
+        slabs = slab;
+        slabUsed = 0;
+    }
+
+    // makes sure the next count allocations do not need more than one new slab
+    void reserveNodes(size_t count)
+    {
+        size_t available = slabs ? slabs->capacity - slabUsed : 0;
+        if (available >= count)
+            return;
+
+        size_t missing = count - available;
+        addSlab(missing > SinglyLinkedListConstants::MIN_SLAB_NODES ? missing : SinglyLinkedListConstants::MIN_SLAB_NODES);
+    }
+
+    void releaseSlot(void* slot)
+    {
+        freeSlots = new (slot) FreeSlot { freeSlots };
+    }
+
+    Node* createNode(const T& data, Node* next = nullptr)
+    {
+        void* slot = allocateSlot();
+        try {
+            return new (slot) Node(data, next);
+        } catch (...) {
+            releaseSlot(slot);
+            throw;
+        }
+    }
+
+    void destroyNode(Node* node)
+    {
+        node->~Node();
+        releaseSlot(node);
     }
 
     Node* head;
     Node* tail;
     size_t size;
+
+    Slab* slabs = nullptr;
+    size_t slabUsed = 0;
+    FreeSlot* freeSlots = nullptr;
 };
 
 template <typename T>
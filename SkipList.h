@@ -0,0 +1,438 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace SkipListConstants {
+constexpr unsigned MAX_LEVEL = 32;
+constexpr uint64_t DEFAULT_SEED = 0x9e3779b97f4a7c15ULL;
+};
+
+// Ordered, probabilistically balanced list: level 0 is a sorted DLL, every level above
+// skips roughly 3 out of 4 nodes of the level below, so search/insert/remove are O(log n) expected.
+// Every node is ONE allocation - the data, the level 0 back pointer and the whole tower of forward pointers.
+// KeyOf extracts the key from the stored data (identity for the set, .first for the map).
+template <typename Data, typename Key, typename KeyOf, typename Comparator>
+class SkipList {
+protected:
+    struct Node {
+        Data data;
+        Node* prev;
+        unsigned height;
+
+        Node(const Data& data, unsigned height)
+            : data(data)
+            , prev(nullptr)
+            , height(height)
+        {
+        }
+
+        Node(Data&& data, unsigned height)
+            : data(std::move(data))
+            , prev(nullptr)
+            , height(height)
+        {
+        }
+    };
+
+public:
+    SkipList() { clearHead(); }
+
+    SkipList(const SkipList& other)
+        : compare(other.compare)
+        , randomState(other.randomState)
+    {
+        clearHead();
+        copy(other);
+    }
+
+    SkipList& operator=(const SkipList& other)
+    {
+        if (this != &other) {
+            free();
+            clearHead(); // copy() appends, so it has to start from an empty list
+
+            compare = other.compare;
+            randomState = other.randomState;
+            copy(other);
+        }
+        return *this;
+    }
+
+    SkipList(SkipList&& other) noexcept { move(std::move(other)); }
+
+    SkipList& operator=(SkipList&& other) noexcept
+    {
+        if (this != &other) {
+            free();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~SkipList() { free(); }
+
+    class ConstIterator {
+    public:
+        ConstIterator& operator++()
+        {
+            if (current)
+                current = tower(current)[0];
+            return *this;
+        }
+
+        ConstIterator operator++(int)
+        {
+            ConstIterator temp(*this);
+            ++(*this);
+            return temp;
+        }
+
+        // --cend() is the last element, like in the std containers
+        ConstIterator& operator--()
+        {
+            current = current ? current->prev : owner->tail;
+            return *this;
+        }
+
+        ConstIterator operator--(int)
+        {
+            ConstIterator temp(*this);
+            --(*this);
+            return temp;
+        }
+
+        const Data& operator*() const { return current->data; }
+        const Data* operator->() const { return &current->data; }
+
+        bool operator==(const ConstIterator& rhs) const { return current == rhs.current; }
+        bool operator!=(const ConstIterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        friend class SkipList;
+
+        ConstIterator(const Node* current, const SkipList* owner)
+            : current(current)
+            , owner(owner)
+        {
+        }
+
+        const Node* current;
+        const SkipList* owner;
+    };
+
+    ConstIterator cbegin() const { return ConstIterator(head[0], this); }
+    ConstIterator cend() const { return ConstIterator(nullptr, this); }
+
+    // first element whose key is not less than key, O(log n) expected
+    ConstIterator lowerBound(const Key& key) const
+    {
+        return ConstIterator(findGreaterOrEqual(key), this);
+    }
+
+    // first element whose key is greater than key, O(log n) expected
+    ConstIterator upperBound(const Key& key) const
+    {
+        const Node* node = findGreaterOrEqual(key);
+        if (node && !compare(key, keyOf(node->data)))
+            node = tower(node)[0];
+
+        return ConstIterator(node, this);
+    }
+
+    void clear()
+    {
+        free();
+        clearHead();
+    }
+
+    size_t size() const { return sz; }
+    bool empty() const { return sz == 0; }
+
+protected:
+    // O(log n) expected
+    template <typename D>
+    bool insertData(D&& data)
+    {
+        Node* preds[SkipListConstants::MAX_LEVEL];
+        Node* found = findWithPredecessors(keyOf(data), preds);
+
+        if (found)
+            return false;
+
+        unsigned height = randomHeight();
+        if (height > level) {
+            for (unsigned i = level; i < height; ++i)
+                preds[i] = nullptr;
+            level = height;
+        }
+
+        Node* newNode = createNode(std::forward<D>(data), height);
+        Node** newTower = tower(newNode);
+
+        for (unsigned i = 0; i < height; ++i) {
+            Node** link = forwardLink(preds[i], i);
+            newTower[i] = *link;
+            *link = newNode;
+        }
+
+        newNode->prev = preds[0];
+        if (newTower[0])
+            newTower[0]->prev = newNode;
+        else
+            tail = newNode;
+
+        ++sz;
+        return true;
+    }
+
+    // O(log n) expected
+    bool removeKey(const Key& key)
+    {
+        Node* preds[SkipListConstants::MAX_LEVEL];
+        Node* toDelete = findWithPredecessors(key, preds);
+
+        if (!toDelete)
+            return false;
+
+        Node** deletedTower = tower(toDelete);
+        for (unsigned i = 0; i < toDelete->height; ++i)
+            *forwardLink(preds[i], i) = deletedTower[i];
+
+        if (deletedTower[0])
+            deletedTower[0]->prev = toDelete->prev;
+        else
+            tail = toDelete->prev;
+
+        while (level > 1 && !head[level - 1])
+            --level;
+
+        destroyNode(toDelete);
+        --sz;
+        return true;
+    }
+
+    Node* find(const Key& key) const
+    {
+        Node* node = findGreaterOrEqual(key);
+        return node && !compare(key, keyOf(node->data)) ? node : nullptr;
+    }
+
+private:
+    // the tower of forward pointers lives right behind the node, in the same allocation
+    static constexpr size_t TOWER_OFFSET = (sizeof(Node) + alignof(Node*) - 1) / alignof(Node*) * alignof(Node*);
+    static constexpr size_t NODE_ALIGNMENT = alignof(Node) > alignof(Node*) ? alignof(Node) : alignof(Node*);
+
+    static Node** tower(Node* node)
+    {
+        return reinterpret_cast<Node**>(reinterpret_cast<char*>(node) + TOWER_OFFSET);
+    }
+
+    static Node* const* tower(const Node* node)
+    {
+        return reinterpret_cast<Node* const*>(reinterpret_cast<const char*>(node) + TOWER_OFFSET);
+    }
+
+    // nullptr as predecessor means the head
+    Node** forwardLink(Node* pred, unsigned levelIndex)
+    {
+        return pred ? &tower(pred)[levelIndex] : &head[levelIndex];
+    }
+
+    Node* findGreaterOrEqual(const Key& key) const
+    {
+        Node* const* links = head;
+        Node* next = nullptr;
+
+        for (unsigned i = level; i-- > 0;) {
+            next = links[i];
+            while (next && compare(keyOf(next->data), key)) {
+                links = tower(next);
+                next = links[i];
+            }
+        }
+
+        return next;
+    }
+
+    // fills preds[0, level) with the last node before key on every level, returns the node with key if any
+    Node* findWithPredecessors(const Key& key, Node** preds)
+    {
+        Node* pred = nullptr;
+
+        for (unsigned i = level; i-- > 0;) {
+            Node* next = *forwardLink(pred, i);
+            while (next && compare(keyOf(next->data), key)) {
+                pred = next;
+                next = tower(next)[i];
+            }
+            preds[i] = pred;
+        }
+
+        Node* candidate = *forwardLink(pred, 0);
+        return candidate && !compare(key, keyOf(candidate->data)) ? candidate : nullptr;
+    }
+
+    // geometric with p = 1/4 - two random bits per level
+    unsigned randomHeight()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 7;
+        randomState ^= randomState << 17;
+
+        uint64_t bits = randomState;
+        unsigned height = 1;
+        while (height < SkipListConstants::MAX_LEVEL && (bits & 3) == 0) {
+            ++height;
+            bits >>= 2;
+        }
+
+        return height;
+    }
+
+    template <typename D>
+    Node* createNode(D&& data, unsigned height)
+    {
+        void* memory = ::operator new(TOWER_OFFSET + height * sizeof(Node*), std::align_val_t(NODE_ALIGNMENT));
+
+        try {
+            return new (memory) Node(std::forward<D>(data), height);
+        } catch (...) {
+            ::operator delete(memory, std::align_val_t(NODE_ALIGNMENT));
+            throw;
+        }
+    }
+
+    static void destroyNode(Node* node)
+    {
+        node->~Node();
+        ::operator delete(node, std::align_val_t(NODE_ALIGNMENT));
+    }
+
+    void clearHead()
+    {
+        for (unsigned i = 0; i < SkipListConstants::MAX_LEVEL; ++i)
+            head[i] = nullptr;
+
+        tail = nullptr;
+        level = 1;
+        sz = 0;
+    }
+
+    // other is already sorted, so we just append and keep the last node of every level at hand
+    void copy(const SkipList& other)
+    {
+        Node* lastOnLevel[SkipListConstants::MAX_LEVEL] = {};
+
+        for (const Node* current = other.head[0]; current; current = tower(current)[0]) {
+            Node* newNode = createNode(current->data, current->height);
+            Node** newTower = tower(newNode);
+
+            for (unsigned i = 0; i < current->height; ++i) {
+                newTower[i] = nullptr;
+                *forwardLink(lastOnLevel[i], i) = newNode;
+                lastOnLevel[i] = newNode;
+            }
+
+            newNode->prev = tail;
+            tail = newNode;
+            ++sz;
+        }
+
+        level = other.level;
+    }
+
+    void move(SkipList&& other)
+    {
+        for (unsigned i = 0; i < SkipListConstants::MAX_LEVEL; ++i)
+            head[i] = other.head[i];
+
+        tail = other.tail;
+        level = other.level;
+        sz = other.sz;
+        randomState = other.randomState;
+        compare = other.compare;
+
+        other.clearHead();
+    }
+
+    void free()
+    {
+        Node* current = head[0];
+        while (current) {
+            Node* toDelete = current;
+            current = tower(current)[0];
+            destroyNode(toDelete);
+        }
+    }
+
+    Node* head[SkipListConstants::MAX_LEVEL];
+    Node* tail = nullptr;
+    unsigned level = 1;
+    size_t sz = 0;
+
+    Comparator compare;
+    KeyOf keyOf;
+    uint64_t randomState = SkipListConstants::DEFAULT_SEED;
+};
+
+template <typename T>
+struct SkipListIdentityKey {
+    const T& operator()(const T& data) const { return data; }
+};
+
+template <typename Key, typename Value>
+struct SkipListPairKey {
+    const Key& operator()(const std::pair<Key, Value>& data) const { return data.first; }
+};
+
+template <typename T, typename Comparator = std::less<T>>
+class SkipListSet : public SkipList<T, T, SkipListIdentityKey<T>, Comparator> {
+    typedef SkipList<T, T, SkipListIdentityKey<T>, Comparator> Base;
+
+public:
+    bool insert(const T& element) { return Base::insertData(element); }
+    bool insert(T&& element) { return Base::insertData(std::move(element)); }
+
+    bool contains(const T& element) const { return Base::find(element) != nullptr; }
+
+    bool remove(const T& element) { return Base::removeKey(element); }
+};
+
+template <typename Key, typename Value, typename Comparator = std::less<Key>>
+class SkipListMap : public SkipList<std::pair<Key, Value>, Key, SkipListPairKey<Key, Value>, Comparator> {
+    typedef SkipList<std::pair<Key, Value>, Key, SkipListPairKey<Key, Value>, Comparator> Base;
+
+public:
+    bool insert(const Key& key, const Value& value) { return Base::insertData(std::make_pair(key, value)); }
+    bool insert(const std::pair<Key, Value>& data) { return Base::insertData(data); }
+    bool insert(std::pair<Key, Value>&& data) { return Base::insertData(std::move(data)); }
+
+    Value& get(const Key& key)
+    {
+        typename Base::Node* node = Base::find(key);
+
+        if (!node)
+            throw std::runtime_error("Map does not contain key");
+
+        return node->data.second;
+    }
+
+    const Value& get(const Key& key) const
+    {
+        const typename Base::Node* node = Base::find(key);
+
+        if (!node)
+            throw std::runtime_error("Map does not contain key");
+
+        return node->data.second;
+    }
+
+    bool contains(const Key& key) const { return Base::find(key) != nullptr; }
+
+    bool remove(const Key& key) { return Base::removeKey(key); }
+};
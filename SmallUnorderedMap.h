@@ -0,0 +1,240 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "UnorderedMap.h"
+
+namespace SmallMapConstants {
+constexpr size_t DEFAULT_INLINE_CAPACITY = 8;
+// goes back inline once the hashed map is down to InlineCapacity / SHRINK_DIVISOR elements,
+// so a map hovering around InlineCapacity does not convert back and forth on every insert / remove
+constexpr size_t SHRINK_DIVISOR = 2;
+};
+
+// UnorderedMap for the (very common) maps that stay tiny: up to InlineCapacity pairs live right inside the object
+// in a flat array searched linearly - no buckets, no list nodes, no heap allocation, and no hashing either.
+// The insert that would overflow the array moves everything into an UnorderedMap (behind one pointer, so the
+// inline mode stays small), and removing down to InlineCapacity / SHRINK_DIVISOR moves it back.
+// Both modes keep insertion order, so for_each does not change its order when the mode changes.
+template <typename Key, typename Value, size_t InlineCapacity = SmallMapConstants::DEFAULT_INLINE_CAPACITY,
+    typename Hasher = std::hash<Key>, typename Reduction = ModuloReduction>
+class SmallUnorderedMap {
+    static_assert(InlineCapacity > 0, "The inline array needs at least one slot");
+
+public:
+    typedef std::pair<Key, Value> DataType;
+    typedef UnorderedMap<Key, Value, Hasher, Reduction> LargeMap;
+
+    SmallUnorderedMap() = default;
+
+    SmallUnorderedMap(const SmallUnorderedMap& other) { copy(other); }
+
+    SmallUnorderedMap& operator=(const SmallUnorderedMap& other)
+    {
+        if (this != &other) {
+            clear();
+            copy(other);
+        }
+        return *this;
+    }
+
+    SmallUnorderedMap(SmallUnorderedMap&& other) noexcept { move(std::move(other)); }
+
+    SmallUnorderedMap& operator=(SmallUnorderedMap&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            move(std::move(other));
+        }
+        return *this;
+    }
+
+    ~SmallUnorderedMap() { destroyInline(); }
+
+    // inline: O(InlineCapacity), otherwise amortized O(const); returns false if the key was already there
+    bool insert(const Key& key, const Value& value)
+    {
+        if (large)
+            return large->insert(key, value).second;
+
+        if (findInline(key) != inlineSize)
+            return false;
+
+        if (inlineSize == InlineCapacity) {
+            moveToLarge();
+            return large->insert(key, value).second;
+        }
+
+        new (slot(inlineSize)) DataType(key, value);
+        ++inlineSize;
+
+        return true;
+    }
+
+    // inline: O(InlineCapacity), otherwise amortized O(const)
+    const Value& get(const Key& key) const
+    {
+        const Value* value = find(key);
+        if (!value)
+            throw std::runtime_error("Element not found");
+
+        return *value;
+    }
+
+    Value& modify(const Key& key)
+    {
+        Value* value = find(key);
+        if (!value)
+            throw std::runtime_error("Element not found");
+
+        return *value;
+    }
+
+    bool contains(const Key& key) const { return find(key) != nullptr; }
+
+    // nullptr if there is no such key
+    Value* find(const Key& key)
+    {
+        return const_cast<Value*>(static_cast<const SmallUnorderedMap&>(*this).find(key));
+    }
+
+    const Value* find(const Key& key) const
+    {
+        if (large) {
+            typename LargeMap::ConstDataListIterator iter = large->find(key, large->hashOf(key));
+            return iter != large->cend() ? &iter->second : nullptr;
+        }
+
+        size_t index = findInline(key);
+        return index != inlineSize ? &slot(index)->second : nullptr;
+    }
+
+    // inline: O(InlineCapacity), otherwise amortized O(const) (O(InlineCapacity) when it moves back inline)
+    bool remove(const Key& key)
+    {
+        if (large) {
+            if (!large->remove(key))
+                return false;
+
+            if (large->size() <= InlineCapacity / SmallMapConstants::SHRINK_DIVISOR)
+                moveToInline();
+
+            return true;
+        }
+
+        size_t index = findInline(key);
+        if (index == inlineSize)
+            return false;
+
+        // shifted down instead of swapped with the last one, to keep insertion order
+        for (size_t i = index; i + 1 < inlineSize; ++i)
+            *slot(i) = std::move(*slot(i + 1));
+
+        slot(--inlineSize)->~DataType();
+
+        return true;
+    }
+
+    // fn(const Key&, Value&) for every element in insertion order
+    template <typename Fn>
+    void for_each(Fn fn)
+    {
+        if (large) {
+            for (DataType& element : *large)
+                fn(static_cast<const Key&>(element.first), element.second);
+            return;
+        }
+
+        for (size_t i = 0; i < inlineSize; ++i)
+            fn(static_cast<const Key&>(slot(i)->first), slot(i)->second);
+    }
+
+    // back to the inline mode
+    void clear()
+    {
+        large.reset();
+        destroyInline();
+    }
+
+    size_t size() const { return large ? large->size() : inlineSize; }
+    bool empty() const { return size() == 0; }
+
+    bool is_inline() const { return !large; }
+    static constexpr size_t inline_capacity() { return InlineCapacity; }
+
+private:
+    DataType* slot(size_t index) { return reinterpret_cast<DataType*>(storage) + index; }
+    const DataType* slot(size_t index) const { return reinterpret_cast<const DataType*>(storage) + index; }
+
+    // returns inlineSize if there is no such key
+    size_t findInline(const Key& key) const
+    {
+        size_t index = 0;
+        while (index < inlineSize && !(slot(index)->first == key))
+            ++index;
+
+        return index;
+    }
+
+    void destroyInline()
+    {
+        for (size_t i = 0; i < inlineSize; ++i)
+            slot(i)->~DataType();
+
+        inlineSize = 0;
+    }
+
+    // sized so that a few more inserts do not resize it right away
+    void moveToLarge()
+    {
+        std::unique_ptr<LargeMap> map = std::make_unique<LargeMap>(2 * InlineCapacity, HashMapConstants::INIT_LOAD_FACTOR);
+
+        for (size_t i = 0; i < inlineSize; ++i)
+            map->insert(slot(i)->first, slot(i)->second);
+
+        destroyInline();
+        large = std::move(map);
+    }
+
+    void moveToInline()
+    {
+        for (DataType& element : *large) {
+            new (slot(inlineSize)) DataType(std::move(element));
+            ++inlineSize;
+        }
+
+        large.reset();
+    }
+
+    void copy(const SmallUnorderedMap& other)
+    {
+        if (other.large) {
+            large = std::make_unique<LargeMap>(*other.large);
+            return;
+        }
+
+        for (size_t i = 0; i < other.inlineSize; ++i) {
+            new (slot(i)) DataType(*other.slot(i));
+            ++inlineSize;
+        }
+    }
+
+    void move(SmallUnorderedMap&& other)
+    {
+        large = std::move(other.large);
+
+        for (size_t i = 0; i < other.inlineSize; ++i)
+            new (slot(i)) DataType(std::move(*other.slot(i)));
+
+        inlineSize = other.inlineSize;
+        other.destroyInline();
+    }
+
+    alignas(DataType) unsigned char storage[InlineCapacity * sizeof(DataType)];
+    size_t inlineSize = 0;
+    std::unique_ptr<LargeMap> large; // only set past InlineCapacity elements
+};
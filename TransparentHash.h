@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// A hasher that declares is_transparent lets the hash containers look keys up by
+// any type it can hash and compare with the stored key, without building a Key first.
+template <typename Hasher, typename = void>
+struct IsTransparentHasher : std::false_type { };
+
+template <typename Hasher>
+struct IsTransparentHasher<Hasher, std::void_t<typename Hasher::is_transparent>> : std::true_type { };
+
+// std::string keys looked up by std::string_view / const char* with no temporary string.
+// std::hash<std::string> and std::hash<std::string_view> agree on equal strings, so both hash the same.
+struct TransparentStringHash {
+    typedef void is_transparent;
+
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>()(key); }
+    size_t operator()(const std::string& key) const { return std::hash<std::string_view>()(key); }
+    size_t operator()(const char* key) const { return std::hash<std::string_view>()(key); }
+};
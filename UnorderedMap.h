@@ -1,42 +1,151 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <list>
+#include <memory>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+#include "Prefetch.h"
+#include "TransparentHash.h"
+
 namespace HashMapConstants {
 constexpr double INIT_LOAD_FACTOR = 0.7;
 constexpr size_t INIT_CAPACITY = 16;
 constexpr size_t GROWTH_FACTOR = 2;
+// buckets built / migrated per operation in incremental rehash mode
+constexpr size_t INCREMENTAL_REHASH_STEP = 8;
 };
 
-template <typename Key, typename Value, typename Hasher>
+// Reduction picks how a hash becomes a bucket index (ModuloReduction, MaskReduction, FibonacciReduction - see HashFunctions.h)
+// Allocator is used (rebound) for the element and chain nodes, e.g. PoolAllocator or ArenaAllocator
+template <typename Key, typename Value, typename Hasher = std::hash<Key>, typename Reduction = ModuloReduction,
+    typename Allocator = std::allocator<std::pair<Key, Value>>>
 class UnorderedMap {
 public:
     typedef std::pair<Key, Value> DataType;
-    typedef typename std::list<DataType>::iterator DataListIterator;
-    typedef DataListIterator Bucket;
+    typedef std::list<DataType, typename std::allocator_traits<Allocator>::template rebind_alloc<DataType>> DataList;
+    typedef typename DataList::iterator DataListIterator;
+    typedef typename DataList::const_iterator ConstDataListIterator;
+    typedef std::list<DataListIterator, typename std::allocator_traits<Allocator>::template rebind_alloc<DataListIterator>> Bucket;
+
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename K>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<K>, Key>, int>;
 
     UnorderedMap()
         : UnorderedMap(HashMapConstants::INIT_CAPACITY, HashMapConstants::INIT_LOAD_FACTOR)
     {
     }
 
-    UnorderedMap(size_t initialCapacity, double loadFactor)
-        : collisionBuckets(initialCapacity)
+    explicit UnorderedMap(const Allocator& allocator)
+        : UnorderedMap(HashMapConstants::INIT_CAPACITY, HashMapConstants::INIT_LOAD_FACTOR, allocator)
+    {
+    }
+
+    UnorderedMap(size_t initialCapacity, double loadFactor, const Allocator& allocator = Allocator())
+        : data(allocator)
+        , collisionBuckets(Reduction::bucketCount(initialCapacity), Bucket(allocator))
         , loadFactor(loadFactor)
     {
     }
 
-    // amortized: O(const), worst case: O(n)
-    std::pair<DataListIterator, bool> insert(Key key, Value value)
+    // the buckets hold iterators into our own list, so they cannot be copied as they are
+    UnorderedMap(const UnorderedMap& other)
+        : data(other.data)
+        , hasher(other.hasher)
+        , loadFactor(other.loadFactor)
+        , incrementalRehash(other.incrementalRehash)
+    {
+        resize(other.bucket_count());
+    }
+
+    UnorderedMap& operator=(const UnorderedMap& other)
+    {
+        if (this != &other) {
+            UnorderedMap copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // the moved-from map is empty and not rehashing, so it is usable again right away
+    UnorderedMap(UnorderedMap&& other) noexcept
+        : data(std::move(other.data))
+        , collisionBuckets(std::move(other.collisionBuckets))
+        , hasher(std::move(other.hasher))
+        , loadFactor(other.loadFactor)
+        , incrementalRehash(other.incrementalRehash)
+        , pendingBuckets(std::move(other.pendingBuckets))
+        , pendingBucketCount(other.pendingBucketCount)
+        , oldBuckets(std::move(other.oldBuckets))
+        , oldBucketCount(other.oldBucketCount)
+#ifdef HASH_TABLE_STATS
+        , resizeCounter(other.resizeCounter)
+#endif
+    {
+        other.clear();
+    }
+
+    UnorderedMap& operator=(UnorderedMap&& other) noexcept
+    {
+        if (this != &other) {
+            data = std::move(other.data);
+            collisionBuckets = std::move(other.collisionBuckets);
+            hasher = std::move(other.hasher);
+            loadFactor = other.loadFactor;
+            incrementalRehash = other.incrementalRehash;
+            pendingBuckets = std::move(other.pendingBuckets);
+            pendingBucketCount = other.pendingBucketCount;
+            oldBuckets = std::move(other.oldBuckets);
+            oldBucketCount = other.oldBucketCount;
+#ifdef HASH_TABLE_STATS
+            resizeCounter = other.resizeCounter;
+#endif
+
+            other.clear();
+        }
+        return *this;
+    }
+
+    // In incremental mode growing never happens inside a single insert:
+    // first the bigger bucket array is built a few buckets per insert/modify/remove,
+    // then the old buckets are drained into it a few at a time (lookups check both meanwhile).
+    // Nodes are spliced between the chains, so migration does not allocate.
+    // get/contains/find const never step it: they stay read-only, so concurrent readers are safe
+    // (RcuUnorderedMap relies on that). A read-only workload keeps checking both bucket arrays
+    // until the next write, or until setIncrementalRehash(false) finishes the rehash.
+    void setIncrementalRehash(bool enabled)
+    {
+        if (!enabled)
+            completeRehash();
+
+        incrementalRehash = enabled;
+    }
+
+    bool isRehashing() const { return pendingBucketCount > 0 || !oldBuckets.empty(); }
+
+    // amortized: O(const), worst case: O(n) (O(const) per rehash step in incremental mode)
+    std::pair<DataListIterator, bool> insert(const Key& key, const Value& value)
+    {
+        return insert(key, value, hasher(key)); // O(const), computed once for all tables
+    }
+
+    // the hash must come from hashOf(key) (or the same hasher)
+    std::pair<DataListIterator, bool> insert(const Key& key, const Value& value, size_t hash)
     {
         // reset buckets if needed
         if (collisionBuckets.empty())
-            collisionBuckets.resize(HashMapConstants::INIT_CAPACITY, data.end()); // O(n), rarely happens // this is not proper initialization of the list
+            collisionBuckets.resize(Reduction::bucketCount(HashMapConstants::INIT_CAPACITY), emptyBucket()); // O(n), rarely happens
+
+        rehashStep();
 
-        DataListIterator iter = getCollisionIterator(key); // amortized O(const)
+        DataListIterator iter = getCollisionIterator(key, hash); // amortized O(const)
 
         // check if element already exists
         if (iter != data.end()) // amortized O(const)
@@ -44,77 +153,154 @@ public:
 
         // actual insert
         data.push_back(std::make_pair(key, value)); // O(const)
-        collisionBuckets[hashIndex(key)].push_back(--data.end()); // O(const)
-
-        if (data.size() >= loadFactor * collisionBuckets.size()) // amortized O(const) since it rarely happens
-        {
-            resize(HashMapConstants::GROWTH_FACTOR * collisionBuckets.size()); // O(n)
-            iter = getCollisionIterator(key); // refresh the iterator // O(n)
+        iter = --data.end();
+        collisionBuckets[Reduction::index(hash, collisionBuckets.size())].push_back(iter); // O(const)
+
+        // list iterators survive the rehash, so iter stays valid
+        if (!isRehashing() && data.size() >= loadFactor * collisionBuckets.size()) { // amortized O(const) since it rarely happens
+            if (incrementalRehash) {
+                pendingBucketCount = Reduction::bucketCount(HashMapConstants::GROWTH_FACTOR * collisionBuckets.size());
+                pendingBuckets.reserve(pendingBucketCount); // one allocation, nothing constructed yet
+#ifdef HASH_TABLE_STATS
+                ++resizeCounter.count; // its steps are timed in rehashStep
+#endif
+            } else
+                resize(HashMapConstants::GROWTH_FACTOR * collisionBuckets.size()); // O(n)
         }
 
         return std::make_pair(iter, true); // O(const)
     }
 
     // amortized: O(const), worst case: O(n)
-    Value& get(Key key) const
-    {
-        if (data.empty())
-            throw std::runtime_error("Element not found");
+    Value& get(const Key& key) const { return getImpl(key); }
 
-        DataListIterator iter = getCollisionIterator(key);
-        if (iter != data.end())
-            return iter->second;
+    template <typename K, EnableTransparentLookup<K> = 0>
+    Value& get(const K& key) const { return getImpl(key); }
 
-        throw std::runtime_error("Element not found");
-    }
+    // amortized: O(const), worst case: O(n)
+    Value& modify(const Key& key) { return modifyImpl(key); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    Value& modify(const K& key) { return modifyImpl(key); }
 
     // amortized: O(const), worst case: O(n)
-    Value& modify(Key key)
-    {
-        if (data.empty())
-            throw std::runtime_error("Element not found");
+    bool contains(const Key& key) const { return contains(key, hasher(key)); }
 
-        DataListIterator iter = getCollisionIterator(key);
-        if (iter != data.end())
-            return iter->second;
+    // the hash must come from hashOf(key) (or the same hasher)
+    bool contains(const Key& key, size_t hash) const { return !data.empty() && locate(key, hash).found; }
 
-        throw std::runtime_error("Element not found");
-    }
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& key) const { return contains(key, hasher(key)); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& key, size_t hash) const { return !data.empty() && locate(key, hash).found; }
+
+    // amortized: O(const), worst case: O(n); returns end() if there is no such key
+    DataListIterator find(const Key& key) { return find(key, hasher(key)); }
+
+    DataListIterator find(const Key& key, size_t hash) { return data.empty() ? data.end() : getCollisionIterator(key, hash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    DataListIterator find(const K& key) { return find(key, hasher(key)); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    DataListIterator find(const K& key, size_t hash) { return data.empty() ? data.end() : getCollisionIterator(key, hash); }
+
+    // read-only lookup, returns cend() if there is no such key
+    ConstDataListIterator find(const Key& key, size_t hash) const { return findConst(key, hash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    ConstDataListIterator find(const K& key, size_t hash) const { return findConst(key, hash); }
+
+    size_t hashOf(const Key& key) const { return hasher(key); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    size_t hashOf(const K& key) const { return hasher(key); }
 
     // amortized: O(const), worst case: O(n)
-    bool contains(Key key) const
+    bool remove(const Key& key) { return removeImpl(key, hasher(key)); }
+
+    // the hash must come from hashOf(key) (or the same hasher)
+    bool remove(const Key& key, size_t hash) { return removeImpl(key, hash); }
+
+    // also moves the value out into removed, so find + remove is one lookup
+    bool remove(const Key& key, size_t hash, Value& removed) { return removeImpl(key, hash, &removed); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool remove(const K& key) { return removeImpl(key, hasher(key)); }
+
+    // Batched lookups for long probe streams (e.g. the probe side of a hash join):
+    // a batch is hashed first, then its buckets, chain nodes and elements are prefetched stage by stage,
+    // and only then compared - the cache misses of a batch overlap instead of being paid one by one.
+    // out[i] points to the value of keys[i] or is nullptr; returns how many keys were found
+    size_t get_many(const Key* keys, size_t count, Value** out) const
     {
-        try {
-            get(key);
-        } catch (std::runtime_error& e) {
-            return false;
+        size_t hashes[PrefetchConstants::BATCH_SIZE];
+        size_t found = 0;
+
+        for (size_t start = 0; start < count; start += PrefetchConstants::BATCH_SIZE) {
+            size_t batch = std::min(count - start, PrefetchConstants::BATCH_SIZE);
+            prefetchBatch(keys + start, batch, hashes);
+
+            for (size_t i = 0; i < batch; ++i) {
+                ChainLocation location = data.empty() ? ChainLocation { false, false, 0, {} } : locate(keys[start + i], hashes[i]);
+                out[start + i] = location.found ? &(*location.chainIter)->second : nullptr;
+                found += location.found;
+            }
         }
-        return true;
+
+        return found;
     }
 
-    // O(n)
-    bool remove(Key key)
+    // out[i] = contains(keys[i])
+    void contains_many(const Key* keys, size_t count, bool* out) const
     {
-        if (data.empty())
-            return false;
+        size_t hashes[PrefetchConstants::BATCH_SIZE];
 
-        size_t index = hashIndex(key);
-        DataListIterator iter = getCollisionIterator(key); // amortized O(const)
-        Bucket& bucket = collisionBuckets[index];
+        for (size_t start = 0; start < count; start += PrefetchConstants::BATCH_SIZE) {
+            size_t batch = std::min(count - start, PrefetchConstants::BATCH_SIZE);
+            prefetchBatch(keys + start, batch, hashes);
 
-        if (iter == data.end())
-            return false;
+            for (size_t i = 0; i < batch; ++i)
+                out[start + i] = contains(keys[start + i], hashes[i]);
+        }
+    }
+
+    // same pipelining as get_many; outside incremental mode it grows once up front instead of mid batch
+    // returns how many keys were new (existing keys keep their values)
+    size_t insert_many(const DataType* elements, size_t count)
+    {
+        if (!incrementalRehash)
+            reserveFor(data.size() + count);
 
-        data.erase(iter); // O(const)
-        bucket.erase(iter); // O(n)
+        size_t hashes[PrefetchConstants::BATCH_SIZE];
+        size_t inserted = 0;
 
-        return true;
+        for (size_t start = 0; start < count; start += PrefetchConstants::BATCH_SIZE) {
+            size_t batch = std::min(count - start, PrefetchConstants::BATCH_SIZE);
+
+            for (size_t i = 0; i < batch; ++i)
+                hashes[i] = hasher(elements[start + i].first);
+            prefetchChains(hashes, batch);
+
+            for (size_t i = 0; i < batch; ++i)
+                inserted += insert(elements[start + i].first, elements[start + i].second, hashes[i]).second;
+        }
+
+        return inserted;
     }
 
+    // elements in insertion order
+    DataListIterator begin() { return data.begin(); }
+    DataListIterator end() { return data.end(); }
+    ConstDataListIterator cbegin() const { return data.cbegin(); }
+    ConstDataListIterator cend() const { return data.cend(); }
+
     void clear()
     {
         data.clear();
         collisionBuckets.clear();
+        dropRehashState();
     }
 
     bool empty() const { return data.empty(); }
@@ -122,43 +308,268 @@ public:
     double load_factor() const { return loadFactor; }
     size_t bucket_count() const { return collisionBuckets.size(); }
 
-    // O(n)
+#ifdef HASH_TABLE_STATS
+    // O(n): chain lengths of the buckets (and of the old ones still being drained)
+    HashTableStats stats() const
+    {
+        HashTableStatsDetail::Builder builder("chaining", data.size(), collisionBuckets.size());
+
+        for (const Bucket& chain : collisionBuckets)
+            builder.chain(chain.size());
+        for (const Bucket& chain : oldBuckets)
+            builder.chain(chain.size());
+
+        return builder.build(resizeCounter);
+    }
+#endif
+
+    // O(n), only the buckets are rebuilt - the elements themselves never move
     void resize(size_t newCapacity)
     {
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
+
+        dropRehashState();
+
         collisionBuckets.clear();
-        collisionBuckets.reserve(newCapacity);
+        collisionBuckets.resize(Reduction::bucketCount(newCapacity), emptyBucket());
 
-        for (DataType& element : data)
-            insert(element.first, element.second);
+        for (DataListIterator iter = data.begin(); iter != data.end(); ++iter)
+            collisionBuckets[Reduction::index(hasher(iter->first), collisionBuckets.size())].push_back(iter);
     }
 
 private:
-    // O(const)
-    size_t hashIndex(Key key) const
+    void prefetchBatch(const Key* keys, size_t batch, size_t* hashes) const
     {
-        return hasher(key) % collisionBuckets.size();
+        for (size_t i = 0; i < batch; ++i)
+            hashes[i] = hasher(keys[i]);
+
+        prefetchChains(hashes, batch);
     }
 
+    // one pass per level of indirection: bucket headers, first chain nodes, then the elements they point to
+    // (during an incremental rehash only the new buckets are prefetched)
+    void prefetchChains(const size_t* hashes, size_t batch) const
+    {
+        if (collisionBuckets.empty())
+            return;
+
+        const Bucket* chains[PrefetchConstants::BATCH_SIZE];
+
+        for (size_t i = 0; i < batch; ++i) {
+            chains[i] = &collisionBuckets[Reduction::index(hashes[i], collisionBuckets.size())];
+            prefetchForRead(chains[i]);
+        }
+
+        for (size_t i = 0; i < batch; ++i)
+            if (!chains[i]->empty())
+                prefetchForRead(&chains[i]->front());
+
+        for (size_t i = 0; i < batch; ++i)
+            if (!chains[i]->empty())
+                prefetchForRead(&*chains[i]->front());
+    }
+
+    // enough buckets that elementCount elements fit without a resize
+    void reserveFor(size_t elementCount)
+    {
+        if (isRehashing() || loadFactor <= 0.0)
+            return;
+
+        size_t newCapacity = collisionBuckets.empty() ? Reduction::bucketCount(HashMapConstants::INIT_CAPACITY) : collisionBuckets.size();
+
+        while (elementCount >= loadFactor * newCapacity)
+            newCapacity *= HashMapConstants::GROWTH_FACTOR;
+
+        if (newCapacity != collisionBuckets.size())
+            resize(newCapacity);
+    }
+
+    template <typename K>
+    Value& getImpl(const K& key) const
+    {
+        if (data.empty())
+            throw std::runtime_error("Element not found");
+
+        ChainLocation location = locate(key, hasher(key));
+        if (location.found)
+            return (*location.chainIter)->second;
+
+        throw std::runtime_error("Element not found");
+    }
+
+    template <typename K>
+    ConstDataListIterator findConst(const K& key, size_t hash) const
+    {
+        if (data.empty())
+            return data.cend();
+
+        ChainLocation location = locate(key, hash);
+        return location.found ? ConstDataListIterator(*location.chainIter) : data.cend();
+    }
+
+    template <typename K>
+    Value& modifyImpl(const K& key)
+    {
+        if (data.empty())
+            throw std::runtime_error("Element not found");
+
+        rehashStep();
+
+        DataListIterator iter = getCollisionIterator(key, hasher(key));
+        if (iter != data.end())
+            return iter->second;
+
+        throw std::runtime_error("Element not found");
+    }
+
+    template <typename K>
+    bool removeImpl(const K& key, size_t hash, Value* removed = nullptr)
+    {
+        if (data.empty())
+            return false;
+
+        rehashStep();
+
+        ChainLocation location = locate(key, hash); // amortized O(const)
+        if (!location.found)
+            return false;
+
+        Bucket& chain = location.inOldBuckets ? oldBuckets[location.index] : collisionBuckets[location.index];
+
+        if (removed)
+            *removed = std::move((*location.chainIter)->second);
+
+        data.erase(*location.chainIter); // O(const)
+        chain.erase(location.chainIter); // O(const)
+
+        return true;
+    }
+
+    struct ChainLocation {
+        bool found;
+        bool inOldBuckets;
+        size_t index;
+        typename Bucket::const_iterator chainIter;
+    };
+
     // amortized O(const);
     // worst case: O(n) but it should be VERY small anyway
-    DataListIterator getCollisionIterator(Key key)
+    template <typename K>
+    typename Bucket::const_iterator getChainIterator(const Bucket& chain, const K& key) const
+    {
+        typename Bucket::const_iterator iter = chain.begin();
+        while (iter != chain.end() && !((*iter)->first == key))
+            ++iter;
+
+        return iter;
+    }
+
+    // looks in the current buckets, then in the part of the old ones that is not migrated yet
+    template <typename K>
+    ChainLocation locate(const K& key, size_t hash) const
     {
-        size_t bucketIndex = hashIndex(key); // O(1)
+        size_t index = Reduction::index(hash, collisionBuckets.size());
+        const Bucket& chain = collisionBuckets[index];
+        typename Bucket::const_iterator chainIter = getChainIterator(chain, key);
 
-        Bucket& chain = collisionBuckets[bucketIndex]; // we use reference because we want the chain itself, not a perishable copy //O(1)
+        if (chainIter != chain.end())
+            return ChainLocation { true, false, index, chainIter };
 
-        if (chain.empty()) // O(1)
-            return data.end();
+        if (!oldBuckets.empty()) {
+            size_t oldIndex = Reduction::index(hash, oldBucketCount);
 
-        for (DataListIterator iter = chain.begin(); iter != chain.end(); ++iter) // O(n), but should be small
-            if (iter->first == key)
-                return iter;
+            // the old buckets are drained from the back, everything at or past size() is already migrated
+            if (oldIndex < oldBuckets.size()) {
+                const Bucket& oldChain = oldBuckets[oldIndex];
+                chainIter = getChainIterator(oldChain, key);
 
-        return data.end();
+                if (chainIter != oldChain.end())
+                    return ChainLocation { true, true, oldIndex, chainIter };
+            }
+        }
+
+        return ChainLocation { false, false, index, chain.end() };
     }
 
-    std::list<DataType> data;
+    // amortized O(const);
+    // worst case: O(n) but it should be VERY small anyway
+    template <typename K>
+    DataListIterator getCollisionIterator(const K& key, size_t hash)
+    {
+        ChainLocation location = locate(key, hash);
+        return location.found ? *location.chainIter : data.end();
+    }
+
+    // O(const): one step of building the new buckets or of draining the old ones into them
+    void rehashStep()
+    {
+        if (!isRehashing())
+            return;
+
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter, false);
+#endif
+
+        if (pendingBucketCount > 0) {
+            for (size_t i = 0; i < HashMapConstants::INCREMENTAL_REHASH_STEP && pendingBuckets.size() < pendingBucketCount; ++i)
+                pendingBuckets.emplace_back(data.get_allocator()); // reserved up front, so this never reallocates
+
+            if (pendingBuckets.size() == pendingBucketCount) {
+                oldBuckets = std::move(collisionBuckets);
+                oldBucketCount = oldBuckets.size();
+                collisionBuckets = std::move(pendingBuckets);
+                pendingBuckets = std::vector<Bucket>();
+                pendingBucketCount = 0;
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < HashMapConstants::INCREMENTAL_REHASH_STEP && !oldBuckets.empty(); ++i) {
+            Bucket& oldChain = oldBuckets.back();
+
+            while (!oldChain.empty()) {
+                Bucket& newChain = collisionBuckets[Reduction::index(hasher(oldChain.front()->first), collisionBuckets.size())];
+                newChain.splice(newChain.end(), oldChain, oldChain.begin());
+            }
+
+            oldBuckets.pop_back();
+        }
+
+        if (oldBuckets.empty())
+            oldBuckets = std::vector<Bucket>(); // releases the (now empty) old array
+    }
+
+    // the chains share the element list's allocator, so nodes can be spliced between them
+    Bucket emptyBucket() const { return Bucket(data.get_allocator()); }
+
+    void completeRehash()
+    {
+        while (isRehashing())
+            rehashStep();
+    }
+
+    void dropRehashState()
+    {
+        pendingBuckets = std::vector<Bucket>();
+        pendingBucketCount = 0;
+        oldBuckets = std::vector<Bucket>();
+        oldBucketCount = 0;
+    }
+
+    DataList data;
     std::vector<Bucket> collisionBuckets;
     Hasher hasher;
     double loadFactor;
+
+    bool incrementalRehash = false;
+    std::vector<Bucket> pendingBuckets; // reserved up front, filled a few buckets per operation
+    size_t pendingBucketCount = 0; // bucket count the rehash in progress grows to, 0 = none
+    std::vector<Bucket> oldBuckets; // drained from the back a few buckets per operation
+    size_t oldBucketCount = 0;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
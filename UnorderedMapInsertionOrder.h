@@ -1,28 +1,68 @@
 #pragma once
 
+#include <functional>
 #include <list>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-namespace HashMapConstants {
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+#include "TransparentHash.h"
+
+namespace InsertionOrderMapConstants {
 constexpr double INIT_LOAD_FACTOR = 0.7;
 constexpr size_t INIT_SIZE = 8;
 constexpr size_t GROWTH_FACTOR = 2;
 };
 
-template <typename K, typename V, typename Hasher = std::hash<K>>
+// Reduction picks how a hash becomes a bucket index (see HashFunctions.h)
+template <typename K, typename V, typename Hasher = std::hash<K>, typename Reduction = ModuloReduction>
 class UnorderedMapInsertionOrder {
+    typedef std::pair<K, V> DataType;
+    typedef std::list<DataType> DataList;
+    typedef typename DataList::iterator DataIterator;
+    typedef typename DataList::const_iterator ConstDataIterator;
+    typedef std::list<DataIterator> Bucket;
+    typedef typename Bucket::const_iterator BucketIterator;
+
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename Other>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<Other>, K>, int>;
+
 public:
-    UnorderedMapInsertionOrder(size_t initialCapacity = HashMapConstants::INIT_SIZE,
-        double loadFactor = HashMapConstants::INIT_LOAD_FACTOR)
-        : collisionBuckets(INIT_SIZE)
+    UnorderedMapInsertionOrder(size_t initialCapacity = InsertionOrderMapConstants::INIT_SIZE,
+        double loadFactor = InsertionOrderMapConstants::INIT_LOAD_FACTOR)
+        : collisionBuckets(Reduction::bucketCount(initialCapacity > 0 ? initialCapacity : InsertionOrderMapConstants::INIT_SIZE))
         , loadFactor(loadFactor)
     {
         if (loadFactor <= 0.0)
             throw std::logic_error("Cannot initialize hash set with non-positive load factor");
     }
 
+    // the buckets hold iterators into our own list, so they are rebuilt instead of copied
+    UnorderedMapInsertionOrder(const UnorderedMapInsertionOrder& other)
+        : data(other.data)
+        , hash(other.hash)
+        , loadFactor(other.loadFactor)
+        , sz(other.sz)
+    {
+        resize(other.collisionBuckets.size());
+    }
+
+    UnorderedMapInsertionOrder& operator=(const UnorderedMapInsertionOrder& other)
+    {
+        if (this != &other) {
+            UnorderedMapInsertionOrder copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    UnorderedMapInsertionOrder(UnorderedMapInsertionOrder&& other) noexcept = default;
+    UnorderedMapInsertionOrder& operator=(UnorderedMapInsertionOrder&& other) noexcept = default;
+
     void clear()
     {
         data.clear();
@@ -39,130 +79,93 @@ public:
         return static_cast<double>(data.size()) / collisionBuckets.size();
     }
 
-    void resize(size_t newSize)
+#ifdef HASH_TABLE_STATS
+    // O(number of buckets)
+    HashTableStats stats() const
     {
-        collisionBuckets.clear();
-        collisionBuckets.resize(newSize);
+        HashTableStatsDetail::Builder builder("chaining", sz, collisionBuckets.size());
 
-        if (collisionBuckets.size() == 0)
-            return;
+        for (const Bucket& bucket : collisionBuckets)
+            builder.chain(bucket.size());
 
-        for (DataIterator dataIter = data.cbegin(); dataIter != data.cend(); ++dataIter)
-            collisionBuckets[getBucketIndex(dataIter->first)].push_back(dataIter);
+        return builder.build(resizeCounter);
     }
+#endif
 
-    bool insert(const std::pair<K, V>& data)
+    void resize(size_t newSize)
     {
-        const K& key = data.first;
-        size_t bucketIndex = getBucketIndex(key);
-        Bucket& bucket = collisionBuckets[bucketIndex];
-
-        auto bucketIterator = getBucketIterator(key, bucket);
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
 
-        if (bucketIterator != bucket.end())
-            return false;
-
-        data.push_front(data);
-        bucket.push_front(--data.end());
-        ++sz;
+        collisionBuckets.clear();
+        collisionBuckets.resize(Reduction::bucketCount(newSize));
 
-        if (current_load_factor() >= max_load_factor())
-            resize(calculateExpandingSize());
+        if (collisionBuckets.size() == 0)
+            return;
 
-        return true;
+        for (DataIterator dataIter = data.begin(); dataIter != data.end(); ++dataIter)
+            collisionBuckets[getBucketIndex(hash(dataIter->first))].push_back(dataIter);
     }
 
-    bool insert(std::pair<K, V>&& data)
+    bool insert(const std::pair<K, V>& element) { return insertImpl(element, hash(element.first)); }
+    bool insert(std::pair<K, V>&& element)
     {
-        const K& key = data.first;
-        size_t bucketIndex = getBucketIndex(key);
-        Bucket& bucket = collisionBuckets[bucketIndex];
-
-        auto bucketIterator = getBucketIterator(key, bucket);
-
-        if (bucketIterator != bucket.end())
-            return false;
-
-        data.push_front(std::move(data));
-        bucket.push_front(--data.end());
-        ++sz;
-
-        if (current_load_factor() >= max_load_factor())
-            resize(calculateExpandingSize());
-
-        return true;
+        size_t keyHash = hash(element.first);
+        return insertImpl(std::move(element), keyHash);
     }
 
     bool insert(const K& key, const V& value)
     {
-        return insert(std::make_pair(key, value);)
+        return insert(std::make_pair(key, value));
     }
 
-    V& modify(const K& key)
+    // the hash must come from hashOf(key) (or the same hasher)
+    bool insert(const K& key, const V& value, size_t keyHash)
     {
-        if (empty())
-            throw std::runtime_error("Map is empty.");
-
-        size_t bucketIndex = getBucketIndex(key);
-        Bucket& bucket = collisionBuckets[bucketIndex];
-
-        auto bucketIterator = getBucketIterator(key, bucket);
-
-        if (bucketIterator == bucket.end())
-            throw std::runtime_error("Map does not contain row with specified key.");
-
-        return *bucketIterator->second;
+        return insertImpl(std::make_pair(key, value), keyHash);
     }
 
-    const V& get(const K& key) const
-    {
-        if (empty())
-            throw std::runtime_error("Map is empty.");
+    V& modify(const K& key) { return modifyImpl(key); }
 
-        size_t bucketIndex = getBucketIndex(data.first);
-        Bucket& bucket = collisionBuckets[bucketIndex];
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    V& modify(const Other& key) { return modifyImpl(key); }
 
-        auto bucketIterator = getBucketIterator(data.first, bucket);
+    const V& get(const K& key) const { return getImpl(key); }
 
-        if (bucketIterator == bucket.end())
-            throw std::runtime_error("Map does not contain row with specified key.");
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    const V& get(const Other& key) const { return getImpl(key); }
 
-        return *bucketIterator->second;
-    }
+    bool contains(const K& key) const { return contains(key, hash(key)); }
+    bool contains(const K& key, size_t keyHash) const { return findBucketIterator(key, keyHash) != nullptr; }
 
-    bool contains(const K& key) const
-    {
-        if (!empty())
-            return false;
-        Bucket& bucket = collisionBuckets[getBucketIndex(key)];
-        return getBucketIterator(key, bucket) != bucket.end();
-    }
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    bool contains(const Other& key) const { return contains(key, hash(key)); }
 
-    bool remove(K key)
-    {
-        if (empty())
-            return false;
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    bool contains(const Other& key, size_t keyHash) const { return findBucketIterator(key, keyHash) != nullptr; }
 
-        size_t bucketIndex = getBucketIndex(key);
-        Bucket& bucket = collisionBuckets[bucketIndex];
+    size_t hashOf(const K& key) const { return hash(key); }
 
-        auto bucketIterator = getBucketIterator(key, bucket);
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    size_t hashOf(const Other& key) const { return hash(key); }
 
-        if (bucketIterator == bucket.end())
-            return false;
+    bool remove(const K& key) { return removeImpl(key); }
 
-        data.erase(*bucketIterator);
-        bucket.erase(bucketIterator);
-        --sz;
-
-        return true;
-    }
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    bool remove(const Other& key) { return removeImpl(key); }
 
     class ConstIterator;
 
     ConstIterator cbegin() const { return ConstIterator(data.cbegin()); }
     ConstIterator cend() const { return ConstIterator(data.cend()); }
 
+    // returns cend() if there is no such key
+    ConstIterator find(const K& key, size_t keyHash) const { return findImpl(key, keyHash); }
+
+    template <typename Other, EnableTransparentLookup<Other> = 0>
+    ConstIterator find(const Other& key, size_t keyHash) const { return findImpl(key, keyHash); }
+
 public:
     class ConstIterator {
     public:
@@ -174,7 +177,7 @@ public:
 
         ConstIterator operator++(int)
         {
-            return { current++; }
+            return ConstIterator(current++);
         }
 
         const DataType& operator*() const
@@ -187,12 +190,12 @@ public:
             return &(*current);
         }
 
-        bool operator==(const ConstIterator& rhs)
+        bool operator==(const ConstIterator& rhs) const
         {
             return current == rhs.current;
         }
 
-        bool operator!=(const ConstIterator& rhs)
+        bool operator!=(const ConstIterator& rhs) const
         {
             return !(*this == rhs);
         }
@@ -206,34 +209,115 @@ public:
     };
 
 private:
-    typedef std::pair<K, V> DataType;
-    typedef std::list<DataType> DataList;
-    typedef typename DataList::iterator DataIterator;
-    typedef typename DataList::const_iterator ConstDataIterator;
-    typedef std::list<DataIterator> Bucket;
-    typedef typename Bucket::iterator BucketIterator;
-
-    size_t getBucketIndex(const K& key) const
+    size_t getBucketIndex(size_t keyHash) const
     {
-        return hash(key) % collisionBuckets.size();
+        return Reduction::index(keyHash, collisionBuckets.size());
     }
 
-    BucketIterator getBucketIterator(const K& key, Bucket& bucket)
+    template <typename Other>
+    static BucketIterator getBucketIterator(const Other& key, const Bucket& bucket)
     {
         auto bucketIterator = bucket.begin();
 
-        while (bucketIterator != bucket.end())
-            if (*(bucketIterator++)->first == key)
-                break;
+        while (bucketIterator != bucket.end() && !((*bucketIterator)->first == key))
+            ++bucketIterator;
 
         return bucketIterator;
     }
 
+    // pointer to the bucket entry of key, nullptr if there is none
+    template <typename Other>
+    const DataIterator* findBucketIterator(const Other& key, size_t keyHash) const
+    {
+        if (empty())
+            return nullptr;
+
+        const Bucket& bucket = collisionBuckets[getBucketIndex(keyHash)];
+        BucketIterator bucketIterator = getBucketIterator(key, bucket);
+
+        return bucketIterator != bucket.end() ? &*bucketIterator : nullptr;
+    }
+
+    template <typename Pair>
+    bool insertImpl(Pair&& element, size_t keyHash)
+    {
+        if (collisionBuckets.empty())
+            collisionBuckets.resize(calculateExpandingSize());
+
+        Bucket& bucket = collisionBuckets[getBucketIndex(keyHash)];
+
+        if (getBucketIterator(element.first, bucket) != bucket.end())
+            return false;
+
+        data.push_back(std::forward<Pair>(element));
+        bucket.push_back(--data.end());
+        ++sz;
+
+        if (current_load_factor() >= max_load_factor())
+            resize(calculateExpandingSize());
+
+        return true;
+    }
+
+    template <typename Other>
+    V& modifyImpl(const Other& key)
+    {
+        if (empty())
+            throw std::runtime_error("Map is empty.");
+
+        const DataIterator* found = findBucketIterator(key, hash(key));
+
+        if (!found)
+            throw std::runtime_error("Map does not contain row with specified key.");
+
+        return (*found)->second;
+    }
+
+    template <typename Other>
+    const V& getImpl(const Other& key) const
+    {
+        if (empty())
+            throw std::runtime_error("Map is empty.");
+
+        const DataIterator* found = findBucketIterator(key, hash(key));
+
+        if (!found)
+            throw std::runtime_error("Map does not contain row with specified key.");
+
+        return (*found)->second;
+    }
+
+    template <typename Other>
+    ConstIterator findImpl(const Other& key, size_t keyHash) const
+    {
+        const DataIterator* found = findBucketIterator(key, keyHash);
+        return found ? ConstIterator(*found) : cend();
+    }
+
+    template <typename Other>
+    bool removeImpl(const Other& key)
+    {
+        if (empty())
+            return false;
+
+        Bucket& bucket = collisionBuckets[getBucketIndex(hash(key))];
+        BucketIterator bucketIterator = getBucketIterator(key, bucket);
+
+        if (bucketIterator == bucket.end())
+            return false;
+
+        data.erase(*bucketIterator);
+        bucket.erase(bucketIterator);
+        --sz;
+
+        return true;
+    }
+
     size_t calculateExpandingSize() const
     {
         return collisionBuckets.size() > 0
-            ? collisionBuckets.size() * HashMapConstants::GROWTH_FACTOR
-            : INIT_SIZE;
+            ? collisionBuckets.size() * InsertionOrderMapConstants::GROWTH_FACTOR
+            : Reduction::bucketCount(InsertionOrderMapConstants::INIT_SIZE);
     }
 
     DataList data;
@@ -241,7 +325,10 @@ private:
 
     Hasher hash;
 
-    const double loadFactor;
+    double loadFactor;
     size_t sz = 0;
-    size_t cap;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
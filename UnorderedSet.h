@@ -1,11 +1,81 @@
 #pragma once
 
+#include <functional>
 #include <list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-template <typename T, typename Hasher = std::hash<T>>
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+#include "TransparentHash.h"
+
+namespace UnorderedSetConstants {
+constexpr double INIT_LOAD_FACTOR = 0.7;
+constexpr size_t INIT_SIZE = 8;
+constexpr size_t GROWTH_FACTOR = 2;
+};
+
+// All elements live in one list and every chain is a contiguous run of it,
+// so a bucket only needs to remember where its run starts and how long it is.
+// Reduction picks how a hash becomes a chain index (see HashFunctions.h)
+template <typename T, typename Hasher = std::hash<T>, typename Reduction = ModuloReduction>
 class UnorderedSet {
+    typedef typename std::list<T>::iterator DataIterator;
+    typedef std::pair<DataIterator, size_t> ChainMetaData;
+
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename K>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<K>, T>, int>;
+
 public:
+    typedef T DataType;
+    typedef std::allocator<T> allocator_type;
+
+    UnorderedSet()
+        : UnorderedSet(UnorderedSetConstants::INIT_SIZE, UnorderedSetConstants::INIT_LOAD_FACTOR)
+    {
+    }
+
+    // std::allocator is stateless; this is only here so generic code can build a set like another one
+    explicit UnorderedSet(const allocator_type&)
+        : UnorderedSet()
+    {
+    }
+
+    UnorderedSet(size_t initialSize, double loadFactor)
+        : loadFactor(loadFactor)
+    {
+        if (loadFactor <= 0.0)
+            throw std::logic_error("Cannot initialize hash set with non-positive load factor");
+
+        chainBeginnings.resize(Reduction::bucketCount(initialSize > 0 ? initialSize : UnorderedSetConstants::INIT_SIZE), ChainMetaData(data.end(), 0));
+    }
+
+    // the chains hold iterators into our own list, so they are rebuilt instead of copied
+    UnorderedSet(const UnorderedSet& other)
+        : hash(other.hash)
+        , loadFactor(other.loadFactor)
+    {
+        chainBeginnings.resize(other.chainBeginnings.size(), ChainMetaData(data.end(), 0));
+        for (const T& element : other.data)
+            insert(element);
+    }
+
+    UnorderedSet& operator=(const UnorderedSet& other)
+    {
+        if (this != &other) {
+            UnorderedSet copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    UnorderedSet(UnorderedSet&& other) noexcept = default;
+    UnorderedSet& operator=(UnorderedSet&& other) noexcept = default;
+
     void clear();
 
     size_t size() const;
@@ -17,116 +87,206 @@ public:
         return static_cast<double>(data.size()) / chainBeginnings.size();
     }
 
-    std::pair<DataIterator, bool> insert(const T& key)
+    std::pair<DataIterator, bool> insert(const T& key) { return insert(key, hash(key)); }
+
+    // the hash must come from hashOf(key) (or the same hasher)
+    std::pair<DataIterator, bool> insert(const T& key, size_t keyHash)
     {
-        size_t startOfChainIndex = getHash(key);
-        DataIterator iter = getElementFromChainAtIndex(key, startOfChainIndex);
+        if (chainBeginnings.empty())
+            chainBeginnings.resize(Reduction::bucketCount(UnorderedSetConstants::INIT_SIZE), ChainMetaData(data.end(), 0));
 
-        if (iter != data.end())
-            return std::make_pair<DataIterator, bool>(iter, false);
+        size_t startOfChainIndex = getChainIndex(keyHash);
+        DataIterator iter;
 
-        std::pair<DataIterator, size_t>& currentChainData = chainBeginnings[startOfChainIndex];
+        if (getElementFromChainAtIndex(key, startOfChainIndex, iter))
+            return std::make_pair(iter, false);
 
-        if (currentChainData.second == 0) {
-            data.push_front(key);
-            // since we inserted the NEW element at the front, we take that elements
-            // as the beginning of a NEW chain (with its size being one, incremented later)
-            currentChainData.first = data.begin();
-        } else {
-            // list.insert(iterator, elementToPut) is basically insert_before(iter, element)
-            // and returns iter to newly added element
-            std::pair<DataIterator, size_t> newBeginningOfChain = data.insert(currentChainData.first, element);
-            // update the new beginning of chain
-            currentChainData.first = newBeginningOfChain;
-        }
+        ChainMetaData& currentChainData = chainBeginnings[startOfChainIndex];
+
+        // list.insert(iterator, elementToPut) is basically insert_before(iter, element)
+        // and returns iter to newly added element - it becomes the new beginning of the chain.
+        // For an empty chain the position does not matter, so the front is as good as any.
+        currentChainData.first = data.insert(currentChainData.second == 0 ? data.begin() : currentChainData.first, key);
 
         // always update the count of elements in the current chain
         currentChainData.second++;
+        DataIterator inserted = currentChainData.first;
 
-        if (current_load_factor() >= max_load_factor()) {
-            resize(chainBeginnings.size() * 2);
-            // element might get new place, so we need to refresh the iterator
-            DataIterator newIterator = getElementFromChainAtIndex(key, getHash(key));
-            return std::make_pair(newIterator, true);
-        }
+        // the list nodes do not move on resize, so the iterator stays valid
+        if (current_load_factor() >= max_load_factor())
+            resize(chainBeginnings.size() * UnorderedSetConstants::GROWTH_FACTOR);
 
-        return std::make_pair(currentChainData.first, true);
+        return std::make_pair(inserted, true);
     }
 
-    bool contains(const T& key) const
-    {
-        return get(key) != data.end();
-    }
+    bool contains(const T& key) const { return contains(key, hash(key)); }
+    bool contains(const T& key, size_t keyHash) const { return containsImpl(key, keyHash); }
 
-    DataIterator get(const T& key)
-    {
-        if (empty())
-            return data.end();
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& key) const { return containsImpl(key, hash(key)); }
 
-        return getElementFromChainAtIndex(key, getHash(key));
-    }
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& key, size_t keyHash) const { return containsImpl(key, keyHash); }
 
-    bool remove(const T& key) const
+    DataIterator get(const T& key) { return find(key, hash(key)); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    DataIterator get(const K& key) { return find(key, hash(key)); }
+
+    // returns end() if there is no such key
+    DataIterator find(const T& key, size_t keyHash) { return findImpl(key, keyHash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    DataIterator find(const K& key, size_t keyHash) { return findImpl(key, keyHash); }
+
+    DataIterator end() { return data.end(); }
+
+    // every element once, in no particular order
+    typename std::list<T>::const_iterator cbegin() const { return data.cbegin(); }
+    typename std::list<T>::const_iterator cend() const { return data.cend(); }
+
+    size_t hashOf(const T& key) const { return hash(key); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    size_t hashOf(const K& key) const { return hash(key); }
+
+    bool remove(const T& key) { return removeImpl(key, hash(key)); }
+
+    // the hash must come from hashOf(key) (or the same hasher)
+    bool remove(const T& key, size_t keyHash) { return removeImpl(key, keyHash); }
+
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool remove(const K& key) { return removeImpl(key, hash(key)); }
+
+#ifdef HASH_TABLE_STATS
+    // O(number of chains)
+    HashTableStats stats() const
     {
-        if (empty())
-            return false;
+        HashTableStatsDetail::Builder builder("chaining", data.size(), chainBeginnings.size());
 
-        size_t startOfChainIndex = getHash(key);
-        DataIterator iter = getElementFromChainAtIndex(key, startOfChainIndex);
+        for (const ChainMetaData& chain : chainBeginnings)
+            builder.chain(chain.second);
 
-        if (iter == data.end())
-            return false;
+        return builder.build(resizeCounter);
+    }
+#endif
 
-        std::pair<DataIterator, size_t>& currentChainData = chainBeginnings[startOfChainIndex];
+    size_t bucket_count() const { return chainBeginnings.size(); }
 
-        // if element is the start of the chain, we must update to the next
-        if (iter == currentChainData.first)
-            currentChainData.first = iter + 1;
+    allocator_type get_allocator() const { return data.get_allocator(); }
 
-        data.erase(iter);
-        currentChainData.second--;
-        return true;
+    // fn(element) for the elements of chains [first, last), so disjoint ranges can be read by different threads
+    template <typename Function>
+    void for_each_in_buckets(size_t first, size_t last, Function&& fn) const
+    {
+        for (size_t index = first; index < last; ++index) {
+            DataIterator iter = chainBeginnings[index].first;
+            for (size_t i = 0; i < chainBeginnings[index].second; ++i, ++iter)
+                fn(*iter);
+        }
+    }
+
+    // grows once so that elementCount elements fit without further resizes
+    void reserve(size_t elementCount)
+    {
+        size_t newSize = chainBeginnings.empty() ? UnorderedSetConstants::INIT_SIZE : chainBeginnings.size();
+        while (static_cast<double>(elementCount) >= loadFactor * newSize)
+            newSize *= UnorderedSetConstants::GROWTH_FACTOR;
+
+        if (newSize != chainBeginnings.size())
+            resize(newSize);
     }
 
     void resize(size_t newSize)
     {
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
+
         std::list<T> oldData(std::move(data));
 
         data.clear();
         chainBeginnings.clear();
 
-        chainBeginnings.resize(newSize, std::make_pair(data.end(), 0));
+        chainBeginnings.resize(Reduction::bucketCount(newSize), ChainMetaData(data.end(), 0));
 
-        for (auto& el : oldData)
-            insert(el);
+        // the nodes are spliced back one by one, so nothing is copied or allocated
+        while (!oldData.empty()) {
+            ChainMetaData& chain = chainBeginnings[getChainIndex(hash(oldData.front()))];
+            DataIterator position = chain.second == 0 ? data.begin() : chain.first;
+
+            data.splice(position, oldData, oldData.begin());
+            chain.first = std::prev(position);
+            chain.second++;
+        }
     }
 
 private:
-    typedef typename std::list<T>::iterator DataIterator;
-    typedef std::pair<DataIterator, size_t> ChainMetaData;
-
-    size_t getHash(const T& key) const
+    size_t getChainIndex(size_t keyHash) const
     {
-        return hash(key) % chainBeginnings.size();
+        return Reduction::index(keyHash, chainBeginnings.size());
     }
 
-    DataIterator getElementFromChainAtIndex(const T& key, size_t index)
+    template <typename K>
+    bool getElementFromChainAtIndex(const K& key, size_t index, DataIterator& result) const
     {
         size_t chainSize = chainBeginnings[index].second;
 
         if (chainSize == 0) // if data was empty, this would still hold true, since it points nothing of use
-            return data.end();
+            return false;
 
         DataIterator iter = chainBeginnings[index].first;
 
         // iter is guaranteed to point to a chain, since the chainSize now says this chain has elements
         for (size_t i = 0; i < chainSize; ++i) {
-            if (*iter == key)
-                return iter;
+            if (*iter == key) {
+                result = iter;
+                return true;
+            }
             iter++; // continue if not found
         }
 
-        return data.end();
+        return false;
+    }
+
+    template <typename K>
+    bool containsImpl(const K& key, size_t keyHash) const
+    {
+        DataIterator iter;
+        return !empty() && getElementFromChainAtIndex(key, getChainIndex(keyHash), iter);
+    }
+
+    template <typename K>
+    DataIterator findImpl(const K& key, size_t keyHash)
+    {
+        DataIterator iter;
+        if (empty() || !getElementFromChainAtIndex(key, getChainIndex(keyHash), iter))
+            return data.end();
+
+        return iter;
+    }
+
+    template <typename K>
+    bool removeImpl(const K& key, size_t keyHash)
+    {
+        if (empty())
+            return false;
+
+        size_t startOfChainIndex = getChainIndex(keyHash);
+        DataIterator iter;
+
+        if (!getElementFromChainAtIndex(key, startOfChainIndex, iter))
+            return false;
+
+        ChainMetaData& currentChainData = chainBeginnings[startOfChainIndex];
+
+        // if element is the start of the chain, we must update to the next
+        if (iter == currentChainData.first)
+            currentChainData.first = std::next(iter);
+
+        data.erase(iter);
+        currentChainData.second--;
+        return true;
     }
 
     Hasher hash;
@@ -134,23 +294,27 @@ private:
     std::vector<ChainMetaData> chainBeginnings;
 
     double loadFactor;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
 
-template <typename T>
-void UnorderedSet<T, Hasher>::clear()
+template <typename T, typename Hasher, typename Reduction>
+void UnorderedSet<T, Hasher, Reduction>::clear()
 {
     data.clear();
     chainBeginnings.clear();
 }
 
-template <typename T>
-size_t UnorderedSet<T, Hasher>::size() const
+template <typename T, typename Hasher, typename Reduction>
+size_t UnorderedSet<T, Hasher, Reduction>::size() const
 {
     return data.size();
 }
 
-template <typename T>
-bool UnorderedSet<T, Hasher>::empty() const
+template <typename T, typename Hasher, typename Reduction>
+bool UnorderedSet<T, Hasher, Reduction>::empty() const
 {
     return data.empty();
 }
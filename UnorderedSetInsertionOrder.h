@@ -1,172 +1,321 @@
 #pragma once
 
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-namespace HashSetConstants {
-constexpr double INIT_LOAD_FACTOR = 0.7;
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+#include "TransparentHash.h"
+
+namespace InsertionOrderSetConstants {
+// the index is open addressing, so it is kept well below full
+constexpr double INIT_LOAD_FACTOR = 0.66;
 constexpr size_t INIT_SIZE = 8;
 constexpr size_t GROWTH_FACTOR = 2;
+constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t DELETED_SLOT = std::numeric_limits<uint32_t>::max() - 1;
 };
 
-template <typename T, typename Hasher = std::hash<T>>
+// The "compact dict" layout: the elements are appended to one dense array in insertion order,
+// and the hash index is a sparse open addressing array of 4 byte positions in that array.
+// Iterating in insertion order is a linear scan, and an element costs its entry plus a few
+// index bytes instead of two list nodes.
+// Removal leaves a hole in the entries and a DELETED_SLOT in the index;
+// both are cleaned up by a rebuild once the holes outnumber the elements (amortized O(const)).
+// Reduction picks how a hash becomes a home slot (see HashFunctions.h).
+// Allocator is used (rebound) for both arrays, e.g. ArenaAllocator.
+template <typename T, typename Hasher = std::hash<T>, typename Reduction = ModuloReduction, typename Allocator = std::allocator<T>>
 class UnorderedSetInsertionOrder {
-    typedef typename std::list<T>::iterator DataIterator;
-    typedef std::list<DataIterator> BucketOfDataIterators;
+    struct Entry {
+        std::optional<T> value; // empty for a removed element
+        size_t hash;
+    };
+
+    typedef std::vector<Entry, typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>> EntryArray;
+    typedef std::vector<uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint32_t>> IndexArray;
+
+    // lookups by other key types are only offered when the hasher is transparent
+    template <typename K>
+    using EnableTransparentLookup = std::enable_if_t<IsTransparentHasher<Hasher>::value && !std::is_same_v<std::decay_t<K>, T>, int>;
 
 public:
     UnorderedSetInsertionOrder()
-        : UnorderedSetInsertionOrder(HashSetConstants::INIT_SIZE, HashSetConstants::INIT_LOAD_FACTOR)
+        : UnorderedSetInsertionOrder(InsertionOrderSetConstants::INIT_SIZE, InsertionOrderSetConstants::INIT_LOAD_FACTOR)
     {
     }
 
-    UnorderedSetInsertionOrder(size_t initialSize, double loadFactor)
-        : collisionBuckets(initialSize)
+    explicit UnorderedSetInsertionOrder(const Allocator& allocator)
+        : UnorderedSetInsertionOrder(InsertionOrderSetConstants::INIT_SIZE, InsertionOrderSetConstants::INIT_LOAD_FACTOR, allocator)
+    {
+    }
+
+    UnorderedSetInsertionOrder(size_t initialSize, double loadFactor, const Allocator& allocator = Allocator())
+        : entries(allocator)
+        , index(Reduction::bucketCount(initialSize > 0 ? initialSize : InsertionOrderSetConstants::INIT_SIZE), InsertionOrderSetConstants::EMPTY_SLOT, allocator)
         , loadFactor(loadFactor)
     {
-        if (loadFactor <= 0.0)
-            throw std::logic_error("Cannot initialize hash set with non-positive load factor");
+        if (loadFactor <= 0.0 || loadFactor >= 1.0)
+            throw std::logic_error("Load factor of open addressing must be in (0, 1)");
     }
 
+    // also gives both arrays back to the allocator
     void clear()
     {
-        data.clear();
-        collisionBuckets.clear();
+        entries = EntryArray(entries.get_allocator());
+        index = IndexArray(index.get_allocator());
+        usedSlots = 0;
         sz = 0;
     }
 
     double load_factor() const { return loadFactor; }
 
     size_t size() const { return sz; }
-    size_t capacity() const { return cap; }
+    size_t capacity() const { return index.size(); }
 
     bool empty() const { return sz == 0; }
 
-    bool insert(const T& element)
+    // amortized O(const)
+    bool insert(const T& element) { return insertImpl(element, hash(element)); }
+    bool insert(T&& element)
     {
-        size_t bucketIndex = getBucketIndex(element);
-        BucketOfDataIterators& bucket = collisionBuckets[bucketIndex];
+        size_t elementHash = hash(element);
+        return insertImpl(std::move(element), elementHash);
+    }
 
-        auto bucketIterator = getBucketIterator(element, bucket);
+    // amortized O(const)
+    bool contains(const T& element) const { return findSlot(element, hash(element)) != index.size(); }
 
-        if (bucketIterator != bucket.end())
-            return false;
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool contains(const K& element) const { return findSlot(element, hash(element)) != index.size(); }
 
-        data.push_back(element);
-        bucket.push_front(--data.end()); // since the new element is pushed in the end, we just get exactly that place as an iterator
-        ++sz;
+    // amortized O(const)
+    bool remove(const T& element) { return removeImpl(element); }
 
-        if ((double)size() >= loadFactor * collisionBuckets.capacity())
-            resize(collisionBuckets.size() > 0
-                    ? collisionBuckets.capacity() * HashSetConstants::GROWTH_FACTOR
-                    : HashSetConstants::INIT_SIZE);
+    template <typename K, EnableTransparentLookup<K> = 0>
+    bool remove(const K& element) { return removeImpl(element); }
 
-        return true;
+    // O(n), also squeezes the holes out of the entries
+    void resize(size_t newBucketCount)
+    {
+        if (static_cast<double>(sz) > loadFactor * Reduction::bucketCount(newBucketCount))
+            throw std::logic_error("Cannot resize below the current number of elements");
+
+        rebuild(newBucketCount);
     }
 
-    bool insert(T&& element)
+#ifdef HASH_TABLE_STATS
+    // O(capacity): probe distances of the index, deleted slots as tombstones
+    HashTableStats stats() const
     {
-        size_t bucketIndex = getBucketIndex(element);
-        BucketOfDataIterators& bucket = collisionBuckets[bucketIndex];
+        HashTableStatsDetail::Builder builder("open addressing", sz, index.size());
+        size_t deletedSlots = 0;
+
+        for (size_t slot = 0; slot < index.size(); ++slot) {
+            uint32_t position = index[slot];
+
+            if (position == InsertionOrderSetConstants::DELETED_SLOT) {
+                ++deletedSlots;
+            } else if (position != InsertionOrderSetConstants::EMPTY_SLOT) {
+                size_t home = homeSlot(entries[position].hash);
+                builder.probe(slot >= home ? slot - home : slot + index.size() - home);
+            }
+        }
 
-        auto bucketIterator = getBucketIterator(element, bucket);
+        builder.tombstones(deletedSlots);
+        return builder.build(resizeCounter);
+    }
+#endif
+
+    class ConstIterator;
+
+    // elements in insertion order
+    ConstIterator cbegin() const { return ConstIterator(entries, 0); }
+    ConstIterator cend() const { return ConstIterator(entries, entries.size()); }
+    ConstIterator begin() const { return cbegin(); }
+    ConstIterator end() const { return cend(); }
+
+    class ConstIterator {
+    public:
+        ConstIterator& operator++()
+        {
+            ++position;
+            skipHoles();
+            return *this;
+        }
 
-        if (bucketIterator != bucket.end())
-            return false;
+        ConstIterator operator++(int)
+        {
+            ConstIterator old(*this);
+            ++(*this);
+            return old;
+        }
 
-        data.push_back(std::move(element));
-        bucket.push_front(--data.end());
-        ++sz;
+        const T& operator*() const { return *(*entries)[position].value; }
+        const T* operator->() const { return &*(*entries)[position].value; }
 
-        if ((double)size() >= loadFactor * collisionBuckets.capacity())
-            resize(collisionBuckets.size() > 0
-                    ? collisionBuckets.capacity() * HashSetConstants::GROWTH_FACTOR
-                    : HashSetConstants::INIT_SIZE);
+        bool operator==(const ConstIterator& rhs) const { return position == rhs.position; }
+        bool operator!=(const ConstIterator& rhs) const { return !(*this == rhs); }
 
-        return true;
+    private:
+        friend class UnorderedSetInsertionOrder;
+
+        ConstIterator(const EntryArray& entries, size_t position)
+            : entries(&entries)
+            , position(position)
+        {
+            skipHoles();
+        }
+
+        void skipHoles()
+        {
+            while (position < entries->size() && !(*entries)[position].value.has_value())
+                ++position;
+        }
+
+        const EntryArray* entries;
+        size_t position;
+    };
+
+private:
+    size_t homeSlot(size_t elementHash) const
+    {
+        return Reduction::index(elementHash, index.size());
     }
 
-    bool contains(const T& element) const
+    size_t nextSlot(size_t slot) const
     {
-        if (empty())
-            return false;
+        return slot + 1 < index.size() ? slot + 1 : 0;
+    }
+
+    // the index slot pointing at element, index.size() if there is none
+    template <typename K>
+    size_t findSlot(const K& element, size_t elementHash) const
+    {
+        if (sz == 0)
+            return index.size();
 
-        size_t bucketIndex = getBucketIndex(element);
-        BucketOfDataIterators& bucket = collisionBuckets[bucketIndex];
+        // the load factor keeps at least one slot empty, so the probe always ends
+        for (size_t slot = homeSlot(elementHash);; slot = nextSlot(slot)) {
+            uint32_t position = index[slot];
 
-        auto bucketIterator = getBucketIterator(element, bucket);
-        return bucketIterator != bucket.end());
+            if (position == InsertionOrderSetConstants::EMPTY_SLOT)
+                return index.size();
+
+            if (position != InsertionOrderSetConstants::DELETED_SLOT
+                && entries[position].hash == elementHash && *entries[position].value == element)
+                return slot;
+        }
     }
 
-    bool remove(const T& element)
+    template <typename U>
+    bool insertImpl(U&& element, size_t elementHash)
     {
-        if (empty())
+        if (index.empty())
+            index.assign(Reduction::bucketCount(InsertionOrderSetConstants::INIT_SIZE), InsertionOrderSetConstants::EMPTY_SLOT);
+
+        if (findSlot(element, elementHash) != index.size())
             return false;
 
-        size_t bucketIndex = getBucketIndex(element);
-        BucketOfDataIterators& bucket = collisionBuckets[bucketIndex];
+        if (entries.size() >= InsertionOrderSetConstants::DELETED_SLOT)
+            throw std::length_error("Too many elements for a 32 bit index");
+
+        // reuses the first deleted slot on the probe path, otherwise takes the empty one that ended it
+        size_t slot = homeSlot(elementHash);
+        while (index[slot] != InsertionOrderSetConstants::EMPTY_SLOT && index[slot] != InsertionOrderSetConstants::DELETED_SLOT)
+            slot = nextSlot(slot);
 
-        auto bucketIterator = getBucketIterator(element, bucket);
+        if (index[slot] == InsertionOrderSetConstants::EMPTY_SLOT) {
+            if (static_cast<double>(usedSlots + 1) > loadFactor * index.size()) {
+                rebuild(grownCapacity());
+                slot = freeSlot(elementHash); // EMPTY_SLOT now, there are no deleted slots after a rebuild
+            }
+            ++usedSlots;
+        }
+
+        entries.push_back(Entry { std::optional<T>(std::forward<U>(element)), elementHash });
+        index[slot] = static_cast<uint32_t>(entries.size() - 1);
+        ++sz;
 
-        // Since bucket.end() (and data.end()) is (are) basically "nothing"/"non-existing element",
-        // semantically we can say they are the same and this can check if we found the element
-        // without using contains() method or getDataIterator() method, which can slow the program by half otherwise.
-        if (bucketIterator == bucket.end())
+        return true;
+    }
+
+    template <typename K>
+    bool removeImpl(const K& element)
+    {
+        size_t slot = findSlot(element, hash(element));
+        if (slot == index.size())
             return false;
 
-        // This is how we can use the very iterator to remove the element from the data list and its iterator from bucket
-        data.erase(*bucketIterator); // basically DataIterator, which is what this method requires
-        bucket.erase(bucketIterator);
+        entries[index[slot]].value.reset();
+        index[slot] = InsertionOrderSetConstants::DELETED_SLOT;
         --sz;
 
+        // every rebuild is paid for by at least as many removals as there are elements left
+        if (entries.size() - sz > sz)
+            rebuild(index.size());
+
         return true;
     }
 
-    void resize(size_t newBucketCount)
+    size_t freeSlot(size_t elementHash) const
     {
-        collisionBuckets.clear();
-        collisionBuckets.resize(newBucketCount);
-
-        // changed from insert(eachElement) to directly copying an iterator
-        // because my previous method with inserting is duplicating data.
-        // i could have just copied the data and cleared it after, but this copying method is redundant
-        for (DataIterator dataIter = data.cbegin(); dataIter != data.cend(); ++dataIter) {
-            size_t bucketIndex = getBucketIndex(*dataIter);
-            Bucket& bucket = collisionBuckets[bucketIndex];
-            bucket.push_back(dataIter);
-        }
+        size_t slot = homeSlot(elementHash);
+        while (index[slot] != InsertionOrderSetConstants::EMPTY_SLOT)
+            slot = nextSlot(slot);
+
+        return slot;
     }
 
-private:
-    size_t getBucketIndex(const T& element) const
+    // room for twice the elements, so the next rebuild is at least size() inserts away
+    size_t grownCapacity() const
     {
-        return hash(element) % collisionBuckets.size();
+        size_t newCapacity = index.size();
+        while (static_cast<double>((sz + 1) * InsertionOrderSetConstants::GROWTH_FACTOR) > loadFactor * newCapacity)
+            newCapacity *= InsertionOrderSetConstants::GROWTH_FACTOR;
+
+        return newCapacity;
     }
 
-    typename BucketOfDataIterators::iterator getBucketIterator(const T& element, const BucketOfDataIterators& bucket)
+    // drops the holes from the entries (keeping the order) and rebuilds the index without deleted slots
+    void rebuild(size_t newCapacity)
     {
-        auto bucketIterator = bucket.begin();
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
 
-        while (bucketIterator != bucket.end()) {
-            if (**bucketIterator == element)
-                break;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& entry) { return !entry.value.has_value(); }),
+            entries.end());
 
-            ++bucketIterator;
-        }
+        index.assign(Reduction::bucketCount(newCapacity), InsertionOrderSetConstants::EMPTY_SLOT);
+
+        usedSlots = 0;
+        if (index.empty())
+            return;
 
-        // this way we can point to bucket.end() that we can use as a placeholder for "nothing"/"non-existing element"
+        for (size_t position = 0; position < entries.size(); ++position)
+            index[freeSlot(entries[position].hash)] = static_cast<uint32_t>(position);
 
-        return bucketIterator;
+        usedSlots = entries.size();
     }
 
-    std::list<T> data;
-    std::vector<BucketOfDataIterators> collisionBuckets;
+    EntryArray entries;
+    IndexArray index;
 
     Hasher hash;
 
-    const double loadFactor;
+    double loadFactor;
+    size_t usedSlots = 0; // filled or deleted index slots
     size_t sz = 0;
-    size_t cap;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
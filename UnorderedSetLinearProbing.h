@@ -1,11 +1,47 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-template <typename T>
+#include "HashFunctions.h"
+#include "HashTableStats.h"
+
+namespace LinearProbingConstants {
+constexpr size_t INIT_CAPACITY = 16;
+// Robin Hood keeps the probe lengths short even at high load
+constexpr double INIT_LOAD_FACTOR = 0.85;
+constexpr size_t GROWTH_FACTOR = 2;
+};
+
+// Robin Hood linear probing:
+// every slot remembers how far it is from its home bucket (probeDistance).
+// On insert the element that is further from home keeps the slot ("takes from the rich"),
+// so probe lengths stay close to each other, and a lookup can stop as soon as it meets
+// an element closer to home than itself. Removal shifts the following elements back
+// instead of leaving a tombstone, so deletes never make future probes longer.
+// Reduction picks how a hash becomes a home slot (see HashFunctions.h).
+template <typename T, typename Hasher = std::hash<T>, typename Reduction = ModuloReduction, typename Enable = void>
 class UnorderedSetLinearProbing {
 public:
+    UnorderedSetLinearProbing()
+        : UnorderedSetLinearProbing(LinearProbingConstants::INIT_CAPACITY, LinearProbingConstants::INIT_LOAD_FACTOR)
+    {
+    }
+
+    UnorderedSetLinearProbing(size_t initialCapacity, double loadFactor)
+        : hashSet(Reduction::bucketCount(initialCapacity))
+        , loadFactor(loadFactor)
+    {
+        if (loadFactor <= 0.0 || loadFactor >= 1.0)
+            throw std::logic_error("Load factor of open addressing must be in (0, 1)");
+    }
+
     void clear();
 
     size_t size() const;
@@ -14,126 +50,362 @@ public:
     double max_load_factor() const { return loadFactor; }
     double current_load_factor() const
     {
-        return static_cast<double>(data.size()) / collisionBuckets.size();
+        return hashSet.empty() ? 1.0 : static_cast<double>(sz) / hashSet.size();
     }
 
+    // amortized O(const)
     bool insert(const T& key)
     {
-        if (loadFactor() >= max_load_factor())
-            resize(hashSet.size() * 2);
+        if (contains(key))
+            return false;
 
-        size_t index = getHashedIndex(key);
-
-        while (hasElementAt(index)) {
-            if (hashSet[index].value() == key)
-                return false;
+        if (hashSet.empty() || static_cast<double>(sz + 1) > loadFactor * hashSet.size())
+            resize(hashSet.empty() ? LinearProbingConstants::INIT_CAPACITY : hashSet.size() * LinearProbingConstants::GROWTH_FACTOR);
 
-            index += step;
-        }
-
-        hashSet[index].data = key;
-        hashSet[index].deleted = false;
+        placeElement(T(key));
         ++sz;
         return true;
     }
 
-    // TODO add get() that returns iterator and make contains delegate the get() method
-
+    // amortized O(const), stops early at the first element that is closer to its home than the key would be
     bool contains(const T& key) const
     {
-        size_t index = getHashedIndex(key);
+        return findIndex(key) != hashSet.size();
+    }
 
-        while (hasElementAt(index)) {
-            if (hashSet[index].data.value() == key)
-                return true;
+    // amortized O(const), no tombstones - the rest of the cluster is shifted one slot back
+    bool remove(const T& key)
+    {
+        size_t index = findIndex(key);
+        if (index == hashSet.size())
+            return false;
 
-            index += step;
+        size_t next = getIndexIncrement(index);
+        while (hashSet[next].data.has_value() && hashSet[next].probeDistance > 0) {
+            hashSet[index].data = std::move(hashSet[next].data);
+            hashSet[index].probeDistance = hashSet[next].probeDistance - 1;
+
+            index = next;
+            next = getIndexIncrement(next);
         }
 
-        return false;
+        hashSet[index].data.reset();
+        hashSet[index].probeDistance = 0;
+        --sz;
+        return true;
     }
 
-    bool remove(const T& key) const
+#ifdef HASH_TABLE_STATS
+    // O(n): how far every element is from its home slot
+    HashTableStats stats() const
     {
-        size_t index = getHashedIndex(key);
+        HashTableStatsDetail::Builder builder("open addressing", sz, hashSet.size());
 
-        while (hashSet[index].data.has_value()) {
-            // boolean comparison is faster and the one we prioritize when comparing in deleting
-            if (!hashSet[index].isDeleted && hashSet[index].data.value() == key) {
-                hashSet[index].isDeleted = true;
-                --sz;
-                return true;
-            }
+        for (const Node& node : hashSet)
+            if (node.data.has_value())
+                builder.probe(node.probeDistance);
 
-            index = getIndexIncrement(index);
-        }
-
-        return false;
+        return builder.build(resizeCounter);
     }
+#endif
 
+    // O(n)
     void resize(size_t newSize)
     {
-        auto saveOldData = hashSet;
+        if (static_cast<double>(sz) > loadFactor * newSize)
+            throw std::logic_error("Cannot resize below the current number of elements");
 
-        hashSet.clear();
-        hashSet.resize(newSize);
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
 
-        // restore default "blank" state of "buckets"
-        for (auto& node : hashSet) {
-            node.data.reset();
-            node.deleted = false;
-        }
+        std::vector<Node> oldHashSet(std::move(hashSet));
 
-        // no need to manually rehash and manually put the elements,
-        // use the ready to use insert(), but have to manually nullify size
-        sz = 0;
-        for (auto& node : saveOldData) {
-            if (node.has_value() && !node.deleted)
-                insert(node.data.value());
-        }
+        hashSet.clear();
+        hashSet.resize(Reduction::bucketCount(newSize));
+
+        // the elements are known to be unique, so they skip the lookup in insert()
+        for (Node& node : oldHashSet)
+            if (node.data.has_value())
+                placeElement(std::move(node.data.value()));
     }
 
 private:
     struct Node {
         std::optional<T> data;
-        bool isDeleted = false;
+        size_t probeDistance = 0;
     };
 
-    size_t getHashedIndex(const K& key) const
+    size_t getHashedIndex(const T& key) const
     {
-        return hash(key) % hashSet.size();
+        return Reduction::index(hash(key), hashSet.size());
     }
 
-    bool hasElementAt(size_t index) const
+    size_t getIndexIncrement(size_t index) const
     {
-        return hashSet[index].data.has_value() && !(hashSet[index].isDeleted);
+        return index + step < hashSet.size() ? index + step : 0;
     }
 
-    size_t getIndexIncrement(size_t index) const
+    size_t findIndex(const T& key) const
+    {
+        if (sz == 0)
+            return hashSet.size();
+
+        size_t index = getHashedIndex(key);
+        size_t distance = 0;
+
+        while (hashSet[index].data.has_value() && hashSet[index].probeDistance >= distance) {
+            if (hashSet[index].data.value() == key)
+                return index;
+
+            index = getIndexIncrement(index);
+            ++distance;
+        }
+
+        return hashSet.size();
+    }
+
+    // puts an element that is known not to be in the set, swapping with every "richer" element on the way
+    void placeElement(T&& element)
     {
-        return (index + step) % hashSet.size();
+        T carried(std::move(element));
+        size_t index = getHashedIndex(carried);
+        size_t distance = 0;
+
+        while (hashSet[index].data.has_value()) {
+            if (hashSet[index].probeDistance < distance) {
+                std::swap(carried, hashSet[index].data.value());
+                std::swap(distance, hashSet[index].probeDistance);
+            }
+
+            index = getIndexIncrement(index);
+            ++distance;
+        }
+
+        hashSet[index].data = std::move(carried);
+        hashSet[index].probeDistance = distance;
     }
 
-    std::vector<Node> hashSet = nullptr;
+    std::vector<Node> hashSet;
+    Hasher hash;
+
+    double loadFactor;
     size_t sz = 0;
     const size_t step = 1;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
 };
 
-template <typename T>
-void UnorderedSetLinearProbing<T>::clear()
+template <typename T, typename Hasher, typename Reduction, typename Enable>
+void UnorderedSetLinearProbing<T, Hasher, Reduction, Enable>::clear()
 {
     hashSet.clear();
     sz = 0;
 }
 
-template <typename T>
-size_t UnorderedSetLinearProbing<T>::size() const
+template <typename T, typename Hasher, typename Reduction, typename Enable>
+size_t UnorderedSetLinearProbing<T, Hasher, Reduction, Enable>::size() const
 {
     return sz;
 }
 
-template <typename T>
-bool UnorderedSetLinearProbing<T>::empty() const
+template <typename T, typename Hasher, typename Reduction, typename Enable>
+bool UnorderedSetLinearProbing<T, Hasher, Reduction, Enable>::empty() const
 {
     return size() == 0;
 }
+
+// 32 / 64 bit unsigned keys: one value (the maximum of the type) is reserved to mark an empty slot,
+// so a slot is the bare key - 4 bytes for uint32_t instead of 12-16 with the optional and the distance.
+// Backward-shift deletion leaves no tombstones, so no "deleted" sentinel is needed,
+// and the probe distance is recomputed from the key's hash instead of being stored - which is why
+// this one always has a power of two of slots and masks the mixed hash (Reduction is not used):
+// recomputing a home slot is a multiply-xorshift and an and, not a division.
+// Signed and narrower integers keep the generic layout, so none of their values is taken away.
+template <typename T>
+using EnableIntegerLinearProbing = std::enable_if_t<std::is_unsigned_v<T> && (sizeof(T) == 4 || sizeof(T) == 8)>;
+
+template <typename T, typename Hasher, typename Reduction>
+class UnorderedSetLinearProbing<T, Hasher, Reduction, EnableIntegerLinearProbing<T>> {
+public:
+    static constexpr T EMPTY_KEY = std::numeric_limits<T>::max();
+
+    UnorderedSetLinearProbing()
+        : UnorderedSetLinearProbing(LinearProbingConstants::INIT_CAPACITY, LinearProbingConstants::INIT_LOAD_FACTOR)
+    {
+    }
+
+    UnorderedSetLinearProbing(size_t initialCapacity, double loadFactor)
+        : hashSet(Hashing::roundUpToPowerOfTwo(std::max<size_t>(initialCapacity, 1)), EMPTY_KEY)
+        , mask(hashSet.size() - 1)
+        , loadFactor(loadFactor)
+    {
+        if (loadFactor <= 0.0 || loadFactor >= 1.0)
+            throw std::logic_error("Load factor of open addressing must be in (0, 1)");
+    }
+
+    void clear()
+    {
+        hashSet.clear();
+        mask = 0;
+        sz = 0;
+    }
+
+    size_t size() const { return sz; }
+    bool empty() const { return size() == 0; }
+
+    double max_load_factor() const { return loadFactor; }
+    double current_load_factor() const
+    {
+        return hashSet.empty() ? 1.0 : static_cast<double>(sz) / hashSet.size();
+    }
+
+    // amortized O(const)
+    bool insert(T key)
+    {
+        if (key == EMPTY_KEY)
+            throw std::invalid_argument("The maximal value of the key type is reserved by the set");
+
+        if (contains(key))
+            return false;
+
+        if (hashSet.empty() || static_cast<double>(sz + 1) > loadFactor * hashSet.size())
+            resize(hashSet.empty() ? LinearProbingConstants::INIT_CAPACITY : hashSet.size() * LinearProbingConstants::GROWTH_FACTOR);
+
+        placeElement(key);
+        ++sz;
+        return true;
+    }
+
+    // amortized O(const)
+    bool contains(T key) const
+    {
+        return findIndex(key) != hashSet.size();
+    }
+
+    // amortized O(const)
+    bool remove(T key)
+    {
+        size_t index = findIndex(key);
+        if (index == hashSet.size())
+            return false;
+
+        size_t next = getIndexIncrement(index);
+        while (hashSet[next] != EMPTY_KEY && probeDistance(hashSet[next], next) > 0) {
+            hashSet[index] = hashSet[next];
+            index = next;
+            next = getIndexIncrement(next);
+        }
+
+        hashSet[index] = EMPTY_KEY;
+        --sz;
+        return true;
+    }
+
+#ifdef HASH_TABLE_STATS
+    // O(n): how far every element is from its home slot
+    HashTableStats stats() const
+    {
+        HashTableStatsDetail::Builder builder("open addressing", sz, hashSet.size());
+
+        for (size_t index = 0; index < hashSet.size(); ++index)
+            if (hashSet[index] != EMPTY_KEY)
+                builder.probe(probeDistance(hashSet[index], index));
+
+        return builder.build(resizeCounter);
+    }
+#endif
+
+    // O(n)
+    void resize(size_t newSize)
+    {
+        if (static_cast<double>(sz) > loadFactor * newSize)
+            throw std::logic_error("Cannot resize below the current number of elements");
+
+#ifdef HASH_TABLE_STATS
+        HashTableResizeTimer timer(resizeCounter);
+#endif
+
+        std::vector<T> oldHashSet(std::move(hashSet));
+
+        hashSet.clear();
+        hashSet.resize(Hashing::roundUpToPowerOfTwo(std::max<size_t>(newSize, 1)), EMPTY_KEY);
+        mask = hashSet.size() - 1;
+
+        for (T key : oldHashSet)
+            if (key != EMPTY_KEY)
+                placeElement(key);
+    }
+
+private:
+    // std::hash of an integer is the identity, so the bits are mixed before masking
+    size_t getHashedIndex(T key) const
+    {
+        return static_cast<size_t>(Hashing::mix64(hash(key))) & mask;
+    }
+
+    size_t getIndexIncrement(size_t index) const
+    {
+        return (index + 1) & mask;
+    }
+
+    // how far the key at index is from its home slot (wraps around through the mask)
+    size_t probeDistance(T key, size_t index) const
+    {
+        return (index - getHashedIndex(key)) & mask;
+    }
+
+    size_t findIndex(T key) const
+    {
+        if (sz == 0 || key == EMPTY_KEY)
+            return hashSet.size();
+
+        size_t index = getHashedIndex(key);
+        size_t distance = 0;
+
+        while (hashSet[index] != EMPTY_KEY) {
+            if (hashSet[index] == key)
+                return index;
+
+            if (probeDistance(hashSet[index], index) < distance)
+                break;
+
+            index = getIndexIncrement(index);
+            ++distance;
+        }
+
+        return hashSet.size();
+    }
+
+    void placeElement(T carried)
+    {
+        size_t index = getHashedIndex(carried);
+        size_t distance = 0;
+
+        while (hashSet[index] != EMPTY_KEY) {
+            size_t residentDistance = probeDistance(hashSet[index], index);
+            if (residentDistance < distance) {
+                std::swap(carried, hashSet[index]);
+                distance = residentDistance;
+            }
+
+            index = getIndexIncrement(index);
+            ++distance;
+        }
+
+        hashSet[index] = carried;
+    }
+
+    std::vector<T> hashSet;
+    size_t mask; // hashSet.size() - 1
+    Hasher hash;
+
+    double loadFactor;
+    size_t sz = 0;
+
+#ifdef HASH_TABLE_STATS
+    HashTableResizeCounter resizeCounter;
+#endif
+};
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentLinearProbingSet.h"
+
+// Writers insert overlapping key ranges into a set that starts tiny, so it migrates many times while
+// they run; readers meanwhile check keys the writers have already reported as inserted.
+// Every key must be reported new exactly once, and no inserted key may ever go missing during a migration.
+
+constexpr unsigned WRITERS = 4;
+constexpr unsigned READERS = 2;
+constexpr uint64_t KEYS_PER_WRITER = 200000;
+
+// writer w inserts [w * KEYS_PER_WRITER / 2, w * KEYS_PER_WRITER / 2 + KEYS_PER_WRITER),
+// so every key past the first half range is inserted by two writers
+uint64_t firstKey(unsigned writer) { return writer * KEYS_PER_WRITER / 2; }
+
+int main()
+{
+    ConcurrentLinearProbingSet<uint64_t> set;
+    size_t initialCapacity = set.capacity();
+
+    std::atomic<uint64_t> progress[WRITERS] = {}; // keys [firstKey(w), firstKey(w) + progress[w]) are in
+    std::atomic<size_t> newKeys { 0 };
+    std::atomic<unsigned> writersDone { 0 };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&, w] {
+            size_t reportedNew = 0;
+            for (uint64_t i = 0; i < KEYS_PER_WRITER; ++i) {
+                reportedNew += set.insert(firstKey(w) + i);
+                assert(set.contains(firstKey(w) + i));
+                progress[w].store(i + 1, std::memory_order_release);
+            }
+
+            newKeys += reportedNew;
+            ++writersDone;
+        });
+    }
+
+    for (unsigned r = 0; r < READERS; ++r) {
+        threads.emplace_back([&, r] {
+            uint64_t state = 0x9e3779b97f4a7c15ULL + r;
+
+            while (writersDone.load() < WRITERS) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+
+                unsigned w = static_cast<unsigned>(state % WRITERS);
+                uint64_t done = progress[w].load(std::memory_order_acquire);
+                if (done > 0)
+                    assert(set.contains(firstKey(w) + (state >> 8) % done));
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    uint64_t distinctKeys = firstKey(WRITERS - 1) + KEYS_PER_WRITER;
+
+    assert(newKeys == distinctKeys);
+    assert(set.size() == distinctKeys);
+    assert(set.capacity() >= 16 * initialCapacity); // it really did migrate several times
+
+    for (uint64_t key = 0; key < distinctKeys; ++key)
+        assert(set.contains(key));
+    assert(!set.contains(distinctKeys));
+
+    std::cout << "concurrent linear probing set: ok (" << distinctKeys << " keys, capacity "
+              << initialCapacity << " -> " << set.capacity() << ")\n";
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "CuckooHashSet.h"
+
+// Keys whose hashes collide can never be separated by growing the table; they must end up
+// in the stash instead of making insert grow the table forever.
+
+// only 4 different hashes for all keys
+struct CollidingHash {
+    size_t operator()(int key) const { return static_cast<size_t>(key & 3); }
+};
+
+int main()
+{
+    CuckooHashSet<int, CollidingHash> colliding;
+    size_t inserted = 0;
+    for (int i = 0; i < 1000; ++i)
+        inserted += colliding.insert(i);
+
+    bool insertedAgain = colliding.insert(500);
+    assert(inserted == 1000 && colliding.size() == 1000 && !insertedAgain);
+    assert(colliding.bucket_count() < 1024);
+
+    for (int i = 0; i < 1000; ++i)
+        assert(colliding.contains(i));
+    assert(!colliding.contains(1000));
+
+    size_t removed = 0;
+    for (int i = 0; i < 1000; i += 2)
+        removed += colliding.remove(i);
+    assert(removed == 500);
+    for (int i = 0; i < 1000; ++i)
+        assert(colliding.contains(i) == (i % 2 == 1));
+    assert(colliding.size() == 500);
+
+    CuckooHashSet<int, CollidingHash> copy;
+    copy.insert(-1);
+    copy = colliding;
+    assert(copy.size() == 500 && copy.contains(999) && !copy.contains(-1));
+
+    CuckooHashSet<int, CollidingHash> moved(std::move(copy));
+    assert(moved.size() == 500 && moved.contains(1) && copy.empty() && !copy.contains(1));
+
+    // a normal hasher still grows and keeps the stash empty or tiny
+    CuckooHashSet<uint64_t> regular;
+    inserted = 0;
+    for (uint64_t i = 0; i < 200000; ++i)
+        inserted += regular.insert(i * 0x9e3779b97f4a7c15ULL);
+    assert(inserted == 200000);
+    for (uint64_t i = 0; i < 200000; ++i)
+        assert(regular.contains(i * 0x9e3779b97f4a7c15ULL));
+    assert(regular.size() == 200000 && regular.stash_size() <= CuckooConstants::STASH_SIZE);
+
+    CuckooHashSet<std::string> strings;
+    for (int i = 0; i < 1000; ++i)
+        strings.insert(std::to_string(i));
+    assert(strings.size() == 1000 && strings.contains("999"));
+
+    std::cout << "cuckoo hash set: ok (stash of the colliding set: " << colliding.stash_size() << ")\n";
+    return 0;
+}
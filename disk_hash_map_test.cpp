@@ -0,0 +1,120 @@
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "DiskHashMap.h"
+
+// Fill a DiskHashMap far past its initial buckets (so it splits and chains overflow pages), change and remove
+// some entries, then close and reopen the file: everything must come back, and the reopened map must keep growing.
+
+constexpr uint64_t KEY_COUNT = 200000;
+
+struct Record {
+    uint64_t id;
+    uint32_t version;
+    uint32_t flags;
+};
+
+uint64_t keyOf(uint64_t i) { return i * 0x9e3779b97f4a7c15ULL; }
+
+// every third key removed, every fifth one updated to version 2
+void checkContents(const DiskHashMap<uint64_t, Record>& map, uint64_t count)
+{
+    size_t expected = 0;
+
+    for (uint64_t i = 0; i < count; ++i) {
+        if (i % 3 == 0) {
+            assert(!map.contains(keyOf(i)));
+            continue;
+        }
+
+        Record record = map.get(keyOf(i));
+        assert(record.id == i && record.version == (i % 5 == 0 ? 2u : 1u));
+        ++expected;
+    }
+
+    assert(map.size() == expected);
+}
+
+int main()
+{
+    std::string path = (std::filesystem::temp_directory_path() / "disk_hash_map_test.bin").string();
+    std::filesystem::remove(path);
+
+    size_t bucketsBeforeReopen;
+    {
+        DiskHashMap<uint64_t, Record> map(path);
+        assert(map.empty());
+        size_t initialBuckets = map.bucket_count();
+
+        size_t inserted = 0;
+        for (uint64_t i = 0; i < KEY_COUNT; ++i)
+            inserted += map.insert(keyOf(i), Record { i, 1, 0 });
+        assert(inserted == KEY_COUNT);
+
+        bool insertedAgain = map.insert(keyOf(7), Record { 7, 9, 9 });
+        assert(!insertedAgain && map.get(keyOf(7)).version == 1);
+
+        size_t removed = 0;
+        for (uint64_t i = 0; i < KEY_COUNT; i += 3)
+            removed += map.remove(keyOf(i));
+        assert(removed == (KEY_COUNT + 2) / 3);
+
+        bool removedAgain = map.remove(keyOf(0));
+        assert(!removedAgain);
+
+        for (uint64_t i = 0; i < KEY_COUNT; i += 5)
+            if (i % 3 != 0)
+                map.set(keyOf(i), Record { i, 2, 0 });
+
+        checkContents(map, KEY_COUNT);
+        assert(map.bucket_count() > 64 * initialBuckets); // it really split many times
+
+        bucketsBeforeReopen = map.bucket_count();
+        map.flush();
+    }
+
+    {
+        DiskHashMap<uint64_t, Record> map(path);
+        assert(map.bucket_count() == bucketsBeforeReopen);
+        checkContents(map, KEY_COUNT);
+
+        // the reopened map keeps growing
+        for (uint64_t i = KEY_COUNT; i < 2 * KEY_COUNT; ++i)
+            if (i % 3 != 0)
+                map.insert(keyOf(i), Record { i, i % 5 == 0 ? 2u : 1u, 0 });
+
+        checkContents(map, 2 * KEY_COUNT);
+        // closed without flush(): the pages reach the file when the mapping goes away
+    }
+
+    {
+        DiskHashMap<uint64_t, Record> map(path);
+        checkContents(map, 2 * KEY_COUNT);
+
+        bool threw = false;
+        try {
+            map.set(keyOf(3), Record {});
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // opening with other types is refused
+    bool threw = false;
+    try {
+        DiskHashMap<uint32_t, Record> wrongTypes(path);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::filesystem::remove(path);
+
+    std::cout << "disk hash map round trip: ok\n";
+    return 0;
+}
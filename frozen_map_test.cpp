@@ -0,0 +1,102 @@
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "FrozenMap.h"
+
+// freeze() a map, open the file again and get everything back: every key, every value,
+// the insertion order, and the misses. Re-freezing over a mapped file must not disturb the old view.
+
+template <typename Function>
+bool throws(Function&& fn)
+{
+    try {
+        fn();
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    std::string stringsPath = (std::filesystem::temp_directory_path() / "frozen_map_test_strings.bin").string();
+    std::string numbersPath = (std::filesystem::temp_directory_path() / "frozen_map_test_numbers.bin").string();
+
+    UnorderedMapInsertionOrder<std::string, std::string> strings;
+    for (int i = 0; i < 10000; ++i)
+        strings.insert("key " + std::to_string(i * 7919 % 10000), std::string(i % 50, 'a' + i % 26));
+    strings.insert("", "empty key");
+
+    freeze(strings, stringsPath);
+
+    {
+        FrozenMap<std::string, std::string> frozen(stringsPath);
+        assert(frozen.size() == strings.size());
+
+        for (auto iter = strings.cbegin(); iter != strings.cend(); ++iter) {
+            assert(frozen.contains(iter->first));
+            assert(frozen.get(iter->first) == iter->second);
+        }
+
+        // insertion order survives
+        auto original = strings.cbegin();
+        for (auto element : frozen) {
+            assert(element.first == original->first && element.second == original->second);
+            ++original;
+        }
+        assert(original == strings.cend());
+
+        assert(!frozen.contains("key 10000") && !frozen.contains("key"));
+        assert(throws([&] { frozen.get("missing"); }));
+
+        // the file is replaced, the old mapping stays valid and unchanged
+        UnorderedMapInsertionOrder<std::string, std::string> other;
+        other.insert("only", "one");
+        freeze(other, stringsPath);
+
+        assert(frozen.size() == strings.size() && frozen.get("") == "empty key");
+
+        FrozenMap<std::string, std::string> replaced(stringsPath);
+        assert(replaced.size() == 1 && replaced.get("only") == "one" && !replaced.contains(""));
+    }
+
+    UnorderedMapInsertionOrder<uint64_t, double> numbers;
+    for (uint64_t i = 0; i < 5000; ++i)
+        numbers.insert(i * i, i / 2.0);
+
+    freeze(numbers, numbersPath);
+
+    {
+        FrozenMap<uint64_t, double> frozen(numbersPath);
+        assert(frozen.size() == 5000);
+        for (uint64_t i = 0; i < 5000; ++i)
+            assert(frozen.get(i * i) == i / 2.0);
+        assert(!frozen.contains(2) && !frozen.contains(5000 * 5000));
+
+        // moving hands over the mapping
+        FrozenMap<uint64_t, double> moved(std::move(frozen));
+        assert(moved.get(49) == 3.5 && frozen.size() == 0 && !frozen.contains(49));
+    }
+
+    // an empty map round trips too
+    UnorderedMapInsertionOrder<uint64_t, double> none;
+    freeze(none, numbersPath);
+    {
+        FrozenMap<uint64_t, double> frozen(numbersPath);
+        assert(frozen.empty() && !frozen.contains(0) && frozen.begin() == frozen.end());
+    }
+
+    // opening with other types, or something that is no frozen map, is refused
+    assert(throws([&] { FrozenMap<uint32_t, double> wrongTypes(numbersPath); }));
+    assert(throws([&] { FrozenMap<std::string, std::string> noFile(numbersPath + ".missing"); }));
+
+    std::filesystem::remove(stringsPath);
+    std::filesystem::remove(numbersPath);
+
+    std::cout << "frozen map round trip: ok\n";
+    return 0;
+}
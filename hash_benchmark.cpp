@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "HashFunctions.h"
+#include "UnorderedMap.h"
+
+// Hash quality (avalanche, bucket spread of patterned keys) and throughput
+// (raw hashing, UnorderedMap with every hasher / reduction pairing).
+
+namespace hash_benchmark {
+constexpr int AVALANCHE_SAMPLES = 20000;
+constexpr size_t SPREAD_BUCKETS = 1 << 16;
+constexpr size_t SPREAD_KEYS = 1 << 15;
+constexpr int HASHES_PER_LENGTH = 2000000;
+constexpr size_t MAP_KEYS = 1 << 18;
+
+uint64_t nextRandom(uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// flips every input bit of random inputs and counts how often each output bit flips;
+// ideal is 50% for every pair, the worst deviation from it is printed
+template <typename Hash>
+void avalanche(const char* name, size_t inputBytes, Hash hash)
+{
+    std::vector<uint64_t> flips(inputBytes * 8 * 64, 0);
+    std::vector<unsigned char> input(inputBytes);
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+
+    for (int sample = 0; sample < AVALANCHE_SAMPLES; ++sample) {
+        for (unsigned char& byte : input)
+            byte = static_cast<unsigned char>(nextRandom(state));
+
+        uint64_t original = hash(input.data(), inputBytes);
+
+        for (size_t bit = 0; bit < inputBytes * 8; ++bit) {
+            input[bit / 8] ^= static_cast<unsigned char>(1u << (bit % 8));
+            uint64_t changed = original ^ hash(input.data(), inputBytes);
+            input[bit / 8] ^= static_cast<unsigned char>(1u << (bit % 8));
+
+            for (size_t out = 0; out < 64; ++out)
+                flips[bit * 64 + out] += (changed >> out) & 1;
+        }
+    }
+
+    double worst = 0;
+    for (uint64_t count : flips)
+        worst = std::max(worst, std::fabs(static_cast<double>(count) / AVALANCHE_SAMPLES - 0.5));
+
+    std::cout << "  " << name << ": worst bias " << worst * 100 << "%" << std::endl;
+}
+
+// how many of the buckets patterned keys land in, and the longest chain
+template <typename Hash, typename Reduction>
+void spread(const char* name, uint64_t stride)
+{
+    std::vector<uint32_t> buckets(Reduction::bucketCount(SPREAD_BUCKETS), 0);
+    Hash hash;
+
+    for (uint64_t i = 0; i < SPREAD_KEYS; ++i)
+        ++buckets[Reduction::index(hash(i * stride), buckets.size())];
+
+    size_t used = 0;
+    uint32_t longest = 0;
+    for (uint32_t count : buckets) {
+        used += count > 0;
+        longest = std::max(longest, count);
+    }
+
+    std::cout << "  " << name << ", stride " << stride << ": " << used << " buckets used, longest chain " << longest << std::endl;
+}
+
+template <typename Hash>
+void bytesThroughput(const char* name, size_t length, Hash hash)
+{
+    std::string input(length, 'a');
+    uint64_t state = 1;
+    for (char& c : input)
+        c = static_cast<char>(nextRandom(state));
+
+    int count = static_cast<int>(std::max<size_t>(HASHES_PER_LENGTH / (1 + length / 64), 1000));
+    uint64_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        input[0] = static_cast<char>(i); // keeps the compiler from hoisting the hash out of the loop
+        sink += hash(std::string_view(input));
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << "  " << name << ", " << length << " bytes: " << seconds / count * 1e9 << " ns, "
+              << static_cast<double>(length) * count / seconds / 1e9 << " GB/s (" << (sink & 1) << ")" << std::endl;
+}
+
+// inserts MAP_KEYS strided keys, then looks all of them up plus as many missing ones
+template <typename Hash, typename Reduction>
+void mapThroughput(const char* name, uint64_t stride)
+{
+    UnorderedMap<uint64_t, uint64_t, Hash, Reduction> map;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < MAP_KEYS; ++i)
+        map.insert(i * stride, i);
+    double insertSeconds = secondsSince(start);
+
+    size_t hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < 2 * MAP_KEYS; ++i)
+        hits += map.contains(i * stride);
+    double lookupSeconds = secondsSince(start);
+
+    std::cout << "  " << name << ", stride " << stride << ": insert " << insertSeconds / MAP_KEYS * 1e9
+              << " ns, lookup " << lookupSeconds / (2 * MAP_KEYS) * 1e9 << " ns (" << hits << " hits)" << std::endl;
+}
+}
+
+int main()
+{
+    using namespace hash_benchmark;
+
+    std::cout << "avalanche:" << std::endl;
+    avalanche("std::hash<uint64_t>, 8 bytes", 8, [](const unsigned char* p, size_t) {
+        return static_cast<uint64_t>(std::hash<uint64_t>()(Hashing::read64(p)));
+    });
+    avalanche("Hashing::mix64, 8 bytes", 8, [](const unsigned char* p, size_t) { return Hashing::mix64(Hashing::read64(p)); });
+    avalanche("Hashing::hashBytes, 8 bytes", 8, [](const unsigned char* p, size_t n) { return Hashing::hashBytes(p, n); });
+    avalanche("Hashing::hashBytes, 32 bytes", 32, [](const unsigned char* p, size_t n) { return Hashing::hashBytes(p, n); });
+    avalanche("Hashing::hashBytes, 100 bytes", 100, [](const unsigned char* p, size_t n) { return Hashing::hashBytes(p, n); });
+
+    std::cout << "bucket spread (" << SPREAD_KEYS << " keys, " << SPREAD_BUCKETS << " buckets):" << std::endl;
+    for (uint64_t stride : { 1, 64, 4096 }) {
+        spread<std::hash<uint64_t>, ModuloReduction>("std::hash + modulo", stride);
+        spread<std::hash<uint64_t>, MaskReduction>("std::hash + mask", stride);
+        spread<std::hash<uint64_t>, FibonacciReduction>("std::hash + fibonacci", stride);
+        spread<FastHash, MaskReduction>("FastHash + mask", stride);
+    }
+
+    std::cout << "string hashing:" << std::endl;
+    for (size_t length : { 8, 32, 256, 4096 }) {
+        bytesThroughput("std::hash<std::string_view>", length, std::hash<std::string_view>());
+        bytesThroughput("FastHash", length, FastHash());
+    }
+
+    std::cout << "UnorderedMap<uint64_t, uint64_t>, " << MAP_KEYS << " keys:" << std::endl;
+    for (uint64_t stride : { 1, 64 }) {
+        mapThroughput<std::hash<uint64_t>, ModuloReduction>("std::hash + modulo", stride);
+        mapThroughput<std::hash<uint64_t>, FibonacciReduction>("std::hash + fibonacci", stride);
+        mapThroughput<FastHash, ModuloReduction>("FastHash + modulo", stride);
+        mapThroughput<FastHash, MaskReduction>("FastHash + mask", stride);
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentUnorderedMap.h"
+#include "RcuUnorderedMap.h"
+#include "UnorderedMap.h"
+
+// 99:1 read/write mix on every core, three ways to share one table:
+// one mutex around an UnorderedMap, the lock striped ConcurrentUnorderedMap and the RcuUnorderedMap.
+
+namespace rcu_benchmark {
+constexpr int KEY_COUNT = 1000; // config / routing sized table, every rcu write copies it
+constexpr int OPERATIONS_PER_THREAD = 200000;
+constexpr int WRITE_EVERY = 100; // 1 write per 100 operations
+
+struct MutexMap {
+    bool get(int key, int& result)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!map.contains(key))
+            return false;
+        result = map.get(key);
+        return true;
+    }
+
+    void write(int key, int value)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!map.insert(key, value).second)
+            map.modify(key) = value;
+    }
+
+    std::mutex lock;
+    UnorderedMap<int, int> map;
+};
+
+struct StripedMap {
+    bool get(int key, int& result) { return map.get(key, result); }
+    void write(int key, int value) { map.insert_or_assign(key, value); }
+
+    ConcurrentUnorderedMap<int, int> map;
+};
+
+struct RcuMap {
+    bool get(int key, int& result) { return map.get(key, result); }
+    void write(int key, int value) { map.insert_or_assign(key, value); }
+
+    // one copy for the whole initial load instead of one per key
+    void fill()
+    {
+        map.update([](RcuUnorderedMap<int, int>::Table& table) {
+            for (int key = 0; key < KEY_COUNT; ++key)
+                table.insert(key, key);
+        });
+    }
+
+    RcuUnorderedMap<int, int> map;
+};
+
+uint64_t nextRandom(uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+template <typename Map>
+void fill(Map& map)
+{
+    for (int key = 0; key < KEY_COUNT; ++key)
+        map.write(key, key);
+}
+
+void fill(RcuMap& map)
+{
+    map.fill();
+}
+
+template <typename Map>
+void run(const char* name, Map& map, unsigned threadCount)
+{
+    fill(map);
+
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> hits(threadCount, 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&map, &hits, t]() {
+            uint64_t state = 0x9e3779b97f4a7c15ULL * (t + 1);
+            uint64_t localHits = 0;
+
+            for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                int key = static_cast<int>(nextRandom(state) % KEY_COUNT);
+
+                if (i % WRITE_EVERY == 0) {
+                    map.write(key, i);
+                } else {
+                    int value;
+                    localHits += map.get(key, value);
+                }
+            }
+
+            hits[t] = localHits;
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double totalOperations = static_cast<double>(threadCount) * OPERATIONS_PER_THREAD;
+
+    uint64_t totalHits = 0;
+    for (uint64_t h : hits)
+        totalHits += h;
+
+    std::cout << name << ": " << totalOperations / seconds / 1e6 << " Mops/s"
+              << " (" << seconds << " s, " << totalHits << " hits)" << std::endl;
+}
+}
+
+int main()
+{
+    unsigned threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 4;
+
+    std::cout << threadCount << " threads, " << rcu_benchmark::KEY_COUNT << " keys, 99:1 reads:writes" << std::endl;
+
+    rcu_benchmark::MutexMap mutexMap;
+    rcu_benchmark::run("single mutex", mutexMap, threadCount);
+
+    rcu_benchmark::StripedMap stripedMap;
+    rcu_benchmark::run("lock striped", stripedMap, threadCount);
+
+    rcu_benchmark::RcuMap rcuMap;
+    rcu_benchmark::run("rcu", rcuMap, threadCount);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "SkipList.h"
+
+// Copy assignment into lists that already hold elements: the old nodes must be gone completely,
+// and the copy must be linked correctly both ways.
+
+template <typename List>
+void checkBothWays(const List& list, int first, int count)
+{
+    assert(list.size() == static_cast<size_t>(count));
+
+    int expected = first;
+    for (auto iter = list.cbegin(); iter != list.cend(); ++iter)
+        assert(*iter == expected++);
+    assert(expected == first + count);
+
+    auto iter = list.cend();
+    for (int i = count; i-- > 0;)
+        assert(*--iter == first + i);
+    assert(iter == list.cbegin());
+}
+
+int main()
+{
+    SkipListSet<int> big;
+    for (int i = 0; i < 100000; ++i)
+        big.insert(i);
+
+    SkipListSet<int> small;
+    for (int i = 1000; i < 1003; ++i)
+        small.insert(i);
+
+    big = small;
+    checkBothWays(big, 1000, 3);
+    checkBothWays(small, 1000, 3);
+
+    // the copy is independent of the original and keeps working
+    big.insert(999);
+    big.remove(1001);
+    assert(big.size() == 3 && big.contains(999) && !big.contains(1001) && small.contains(1001));
+
+    SkipListSet<int> empty;
+    small = empty;
+    checkBothWays(small, 0, 0);
+
+    for (int i = 0; i < 50; ++i)
+        small.insert(i);
+    checkBothWays(small, 0, 50);
+
+    small = small;
+    checkBothWays(small, 0, 50);
+
+    SkipListMap<int, std::string> map;
+    for (int i = 0; i < 1000; ++i)
+        map.insert(i, std::to_string(i));
+
+    SkipListMap<int, std::string> other;
+    other.insert(7, "seven");
+
+    map = other;
+    assert(map.size() == 1 && map.get(7) == "seven" && !map.contains(8));
+
+    std::cout << "skip list assignment: ok\n";
+    return 0;
+}